@@ -0,0 +1,87 @@
+#include "authStore.h"
+#include "mysqlAuthStore.h"
+#include "mmapAuthStore.h"
+
+#include <mutex>
+
+AuthStore::Config AuthStore::loadConfigFile()
+{
+    Config cfg;
+    std::ifstream ifs(getConfigPath() + "connPool.conf");
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "authbackend")
+            {
+                std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+                cfg.backend = (value == "mmap") ? BACKEND_MMAP : BACKEND_MYSQL;
+            }
+            else if(key == "authfile")
+            {
+                cfg.file = value;
+            }
+            else if(key == "authcapacity")
+            {
+                cfg.capacity = std::stoul(value);
+            }
+        }
+
+        ifs.close();
+    }
+
+    return cfg;
+}
+
+const AuthStore::Config& AuthStore::config()
+{
+    static Config cfg = loadConfigFile();
+    return cfg;
+}
+
+AuthStore::BACKEND AuthStore::backend()
+{
+    return config().backend;
+}
+
+AuthStore* AuthStore::getInstance()
+{
+    static std::unique_ptr<AuthStore> store;
+    static std::once_flag once;
+
+    std::call_once(once, []{
+        const Config& cfg = config();
+        if(cfg.backend == BACKEND_MMAP)
+        {
+            string path = cfg.file;
+            if(!path.empty() && path[0] != '/')
+            {
+                path = getSrcPath() + "/" + path;
+            }
+            store.reset(new MmapAuthStore(path, cfg.capacity));
+        }
+        else
+        {
+            store.reset(new MysqlAuthStore());
+        }
+    });
+
+    return store.get();
+}
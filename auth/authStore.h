@@ -0,0 +1,57 @@
+#ifndef AUTHSTORE_H
+#define AUTHSTORE_H
+
+#include <string>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  用户表的存储接口，HttpRequest::userVerify 只依赖这个接口
+ *  后端由 connPool.conf 中的 authBackend 选择：
+ *      mysql : DbConnsPool + MySQL（默认）
+ *      mmap  : 内嵌的内存映射哈希表 + 追加日志，不依赖 MySQL
+ */
+class AuthStore
+{
+public:
+    enum BACKEND
+    {
+        BACKEND_MYSQL = 0,
+        BACKEND_MMAP,
+    };
+
+    enum RESULT
+    {
+        AUTH_OK = 0,        // 成功
+        AUTH_FAIL,          // 用户不存在或口令错误
+        AUTH_DUPLICATE,     // 注册时用户名已存在
+        AUTH_ERROR,         // 存储出错
+    };
+
+public:
+    virtual ~AuthStore() = default;
+
+    virtual RESULT verify(const string& name, const string& pwd) = 0;
+    virtual RESULT registerUser(const string& name, const string& pwd) = 0;
+
+    static AuthStore* getInstance();
+    static BACKEND backend();
+
+private:
+    struct Config
+    {
+        BACKEND backend = BACKEND_MYSQL;
+        string file = "data/users.db";      // mmap 后端的表文件，相对项目根目录
+        size_t capacity = 65536;            // mmap 后端的槽位数
+    };
+
+    static const Config& config();
+    static Config loadConfigFile();
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "credentialCache.h"
+
+CredentialCache* CredentialCache::getInstance()
+{
+    static CredentialCache cache;
+    return &cache;
+}
+
+CredentialCache::CredentialCache()
+:m_enable(true), m_shardNum(16), m_capacity(65536), m_ttl(300), m_hits(0), m_misses(0)
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "CredentialCache use default configuration..." << std::endl;
+#endif
+    }
+
+    m_shardNum = std::max(m_shardNum, 1);
+    m_shardCapacity = std::max<size_t>(m_capacity / m_shardNum, 1);
+    for(int i = 0; i < m_shardNum; ++i)
+    {
+        m_shards.emplace_back(new Shard);
+    }
+}
+
+bool CredentialCache::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "credCache.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << m_configPath << std::endl;
+#endif
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "enable")
+            {
+                m_enable = std::stoi(value) != 0;
+            }
+            else if(key == "shards")
+            {
+                m_shardNum = std::stoi(value);
+            }
+            else if(key == "capacity")
+            {
+                m_capacity = std::stoul(value);
+            }
+            else if(key == "ttl")
+            {
+                m_ttl = std::stoi(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+CredentialCache::Shard& CredentialCache::shardOf(const string& name)
+{
+    return *m_shards[std::hash<string>()(name) % m_shards.size()];
+}
+
+string CredentialCache::makeSalt()
+{
+    thread_local std::mt19937_64 gen(std::random_device{}());
+    uint64_t v[2] = { gen(), gen() };
+    return string(reinterpret_cast<char*>(v), sizeof(v));
+}
+
+string CredentialCache::saltedHash(const string& salt, const string& pwd)
+{
+    return Sha256::hash(salt + pwd);
+}
+
+bool CredentialCache::verify(const string& name, const string& pwd)
+{
+    if(!m_enable) return false;
+
+    Shard& shard = shardOf(name);
+    std::unique_lock<std::mutex> locker(shard.mtx);
+
+    auto it = shard.index.find(name);
+    if(it == shard.index.end())
+    {
+        locker.unlock();
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // 过期：删除后按未命中处理
+    auto node = it->second;
+    if(node->expires <= SteadyClock::now())
+    {
+        shard.lru.erase(node);
+        shard.index.erase(it);
+        locker.unlock();
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // 移到 LRU 头部
+    shard.lru.splice(shard.lru.begin(), shard.lru, node);
+    string salt = node->salt;
+    string hash = node->hash;
+    locker.unlock();
+
+    // 哈希计算放在锁外
+    if(saltedHash(salt, pwd) != hash)
+    {
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void CredentialCache::put(const string& name, const string& pwd)
+{
+    if(!m_enable) return;
+
+    string salt = makeSalt();
+    string hash = saltedHash(salt, pwd);
+    SteadyClock::time_point expires = SteadyClock::now() + std::chrono::seconds(m_ttl);
+
+    Shard& shard = shardOf(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+
+    auto it = shard.index.find(name);
+    if(it != shard.index.end())
+    {
+        it->second->salt = std::move(salt);
+        it->second->hash = std::move(hash);
+        it->second->expires = expires;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+
+    // 超出容量，淘汰最久未使用的
+    while(shard.lru.size() >= m_shardCapacity)
+    {
+        shard.index.erase(shard.lru.back().name);
+        shard.lru.pop_back();
+    }
+
+    shard.lru.push_front(Entry{name, std::move(salt), std::move(hash), expires});
+    shard.index[name] = shard.lru.begin();
+}
+
+void CredentialCache::invalidate(const string& name)
+{
+    Shard& shard = shardOf(name);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+
+    auto it = shard.index.find(name);
+    if(it != shard.index.end())
+    {
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+}
+
+size_t CredentialCache::size()
+{
+    size_t total = 0;
+    for(auto& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        total += shard->lru.size();
+    }
+    return total;
+}
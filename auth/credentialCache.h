@@ -0,0 +1,82 @@
+#ifndef CREDENTIALCACHE_H
+#define CREDENTIALCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <algorithm>
+#include <random>
+
+#include "../utils/pathInfo.h"
+#include "../utils/sha256.h"
+
+using std::string;
+
+/**
+ *  登录凭据缓存：挡在 DbConnsPool 前面，重复登录不再访问数据库
+ *  - 按用户名分片，每个分片一把锁，分片内 LRU 淘汰 + TTL 过期
+ *  - 只保存加盐哈希，不保存明文口令
+ */
+class CredentialCache
+{
+public:
+    static CredentialCache* getInstance();
+
+    // 命中且口令匹配返回 true；未命中、过期或不匹配返回 false（调用者回源数据库）
+    bool verify(const string& name, const string& pwd);
+
+    // 数据库校验通过或注册成功后写入
+    void put(const string& name, const string& pwd);
+    void invalidate(const string& name);
+
+    uint64_t getHits() const { return m_hits.load(std::memory_order_relaxed); }
+    uint64_t getMisses() const { return m_misses.load(std::memory_order_relaxed); }
+    size_t size();
+
+private:
+    CredentialCache();
+    bool loadConfigFile();
+
+    using SteadyClock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        string name;
+        string salt;
+        string hash;                    // sha256(salt + pwd)
+        SteadyClock::time_point expires;
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::list<Entry> lru;           // 头部为最近使用
+        std::unordered_map<string, std::list<Entry>::iterator> index;
+    };
+
+    Shard& shardOf(const string& name);
+    string makeSalt();
+
+    static string saltedHash(const string& salt, const string& pwd);
+
+private:
+    bool m_enable;
+    int m_shardNum;
+    size_t m_capacity;          // 总容量，平均分到各分片
+    size_t m_shardCapacity;
+    int m_ttl;                  // 单位：秒
+    string m_configPath;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+};
+
+#endif
@@ -0,0 +1,391 @@
+#include "mmapAuthStore.h"
+
+#include <random>
+
+namespace
+{
+
+const char TABLE_MAGIC[8] = {'W', 'S', 'U', 'S', 'E', 'R', 'S', '1'};
+const uint32_t TABLE_VERSION = 1;
+
+/* 日志记录：| nameLen(2) | name | salt(16) | digest(32) | checksum(4) | */
+uint32_t checksum(const uint8_t* data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+}
+
+MmapAuthStore::MmapAuthStore(const string& path, size_t capacity)
+:m_path(path), m_capacity(2), m_tableFd(-1), m_logFd(-1), m_mapLen(0), m_header(nullptr), m_slots(nullptr)
+{
+    static_assert(sizeof(Header) == 64, "Header size");
+    static_assert(sizeof(Slot) == 128, "Slot size");
+
+    while(m_capacity < capacity) m_capacity <<= 1;
+
+    // 数据目录不存在时先创建
+    size_t pos = m_path.find_last_of('/');
+    if(pos != string::npos && pos > 0)
+    {
+        mkdir(m_path.substr(0, pos).c_str(), 0700);
+    }
+
+    if(!openLog())
+    {
+        LOG_ERROR("auth store open %s.log failed: %s", m_path.c_str(), strerror(errno));
+        return;
+    }
+
+    // 打开、重建和降级期间持有日志锁，进程之间的打开过程互斥：
+    // flock 从排他降为共享不是原子的，中间的空档里另一个进程不能拿到排他锁去清空正在使用的表
+    FileLock openLock(m_logFd);
+
+    bool rebuild = false;
+    if(!openTable(rebuild))
+    {
+        int err = errno;
+        // 打开失败时不保留映射和表文件（及其上的锁），不影响其他进程
+        closeTable();
+#ifdef DEBUG
+        std::cout << "MmapAuthStore open " << m_path << " failed..." << std::endl;
+#endif
+        LOG_ERROR("auth store open %s failed: %s", m_path.c_str(), strerror(err));
+        return;
+    }
+
+    if(rebuild && !replayLog())
+    {
+#ifdef DEBUG
+        std::cout << "MmapAuthStore replay log failed..." << std::endl;
+#endif
+        LOG_ERROR("auth store replay %s.log failed", m_path.c_str());
+    }
+
+    // 运行期间标记为非正常关闭，崩溃后下次启动会从日志重建；在降级之前写入
+    m_header->clean = 0;
+    msync(m_header, sizeof(Header), MS_SYNC);
+
+    // 重建完成后才降为共享锁，同时启动的进程不会看到重建到一半的表
+    flock(m_tableFd, LOCK_SH);
+}
+
+MmapAuthStore::~MmapAuthStore()
+{
+    if(m_header)
+    {
+        msync(m_header, m_mapLen, MS_SYNC);
+        // 另一个进程仍在使用时不标记正常关闭，它崩溃后要能从日志重建
+        // 升级锁同样不是原子的，与其他进程的打开过程互斥
+        FileLock openLock(m_logFd);
+        if(flock(m_tableFd, LOCK_EX | LOCK_NB) == 0)
+        {
+            m_header->clean = 1;
+            msync(m_header, sizeof(Header), MS_SYNC);
+        }
+    }
+
+    closeTable();
+    if(m_logFd >= 0) close(m_logFd);
+}
+
+void MmapAuthStore::closeTable()
+{
+    if(m_header)
+    {
+        munmap(m_header, m_mapLen);
+        m_header = nullptr;
+        m_slots = nullptr;
+    }
+    if(m_tableFd >= 0)
+    {
+        close(m_tableFd);
+        m_tableFd = -1;
+    }
+}
+
+bool MmapAuthStore::openLog()
+{
+    m_logFd = open((m_path + ".log").c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    return m_logFd >= 0;
+}
+
+bool MmapAuthStore::openTable(bool& rebuild)
+{
+    m_tableFd = open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(m_tableFd < 0)
+    {
+        return false;
+    }
+
+    // 调用方持有日志锁，其他进程要么还没开始打开，要么已经完成并持有共享锁
+    // 只有拿到排他锁（没有其他进程打开）才能校验后重建；拿不到时表一定是完整的，只映射不重建
+    bool exclusive = flock(m_tableFd, LOCK_EX | LOCK_NB) == 0;
+    if(!exclusive && flock(m_tableFd, LOCK_SH) < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(m_tableFd, &st) < 0)
+    {
+        return false;
+    }
+
+    // 已有的表：以文件中记录的容量为准
+    Header old;
+    bool valid = static_cast<size_t>(st.st_size) >= sizeof(Header)
+        && pread(m_tableFd, &old, sizeof(old), 0) == static_cast<ssize_t>(sizeof(old))
+        && memcmp(old.magic, TABLE_MAGIC, sizeof(TABLE_MAGIC)) == 0
+        && old.version == TABLE_VERSION
+        && static_cast<size_t>(st.st_size) == sizeof(Header) + old.capacity * sizeof(Slot);
+
+    if(valid)
+    {
+        m_capacity = old.capacity;
+        // 与其他进程共用时 clean 为 0 只因对方仍在运行
+        rebuild = exclusive && old.clean != 1;
+    }
+    else if(exclusive)
+    {
+        rebuild = true;
+    }
+    else
+    {
+        // 持有共享锁的进程都已完成重建，正常不会走到这里；不能在别人映射着的时候清空
+        errno = EBUSY;
+        return false;
+    }
+
+    m_mapLen = sizeof(Header) + m_capacity * sizeof(Slot);
+    if(!valid && ftruncate(m_tableFd, 0) < 0)
+    {
+        return false;
+    }
+    if(ftruncate(m_tableFd, m_mapLen) < 0)
+    {
+        return false;
+    }
+
+    void* addr = mmap(nullptr, m_mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, m_tableFd, 0);
+    if(addr == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_header = static_cast<Header*>(addr);
+    m_slots = reinterpret_cast<Slot*>(static_cast<char*>(addr) + sizeof(Header));
+
+    if(rebuild)
+    {
+        // 清空整张表，随后由日志重建
+        memset(addr, 0, m_mapLen);
+        memcpy(m_header->magic, TABLE_MAGIC, sizeof(TABLE_MAGIC));
+        m_header->version = TABLE_VERSION;
+        m_header->capacity = m_capacity;
+        m_header->count = 0;
+    }
+
+    return true;
+}
+
+bool MmapAuthStore::replayLog()
+{
+    off_t offset = 0;
+    uint8_t rec[2 + NAME_MAX_LEN + SALT_LEN + Sha256::DIGEST_SIZE + 4];
+
+    while(true)
+    {
+        uint16_t nameLen = 0;
+        if(pread(m_logFd, &nameLen, sizeof(nameLen), offset) != sizeof(nameLen))
+        {
+            break;
+        }
+
+        size_t recLen = 2 + nameLen + SALT_LEN + Sha256::DIGEST_SIZE + 4;
+        if(nameLen == 0 || nameLen > NAME_MAX_LEN || pread(m_logFd, rec, recLen, offset) != static_cast<ssize_t>(recLen))
+        {
+            break;      // 尾部不完整的记录（写入中途崩溃），丢弃
+        }
+
+        uint32_t sum;
+        memcpy(&sum, rec + recLen - 4, 4);
+        if(sum != checksum(rec, recLen - 4))
+        {
+            break;
+        }
+
+        string name(reinterpret_cast<char*>(rec + 2), nameLen);
+        const uint8_t* salt = rec + 2 + nameLen;
+        insert(name, hashName(name), salt, salt + SALT_LEN);
+        offset += recLen;
+    }
+
+    // 截掉损坏的尾部，保证之后的追加从完整记录开始
+    return ftruncate(m_logFd, offset) == 0;
+}
+
+bool MmapAuthStore::appendLog(const string& name, const uint8_t* salt, const uint8_t* digest)
+{
+    uint8_t rec[2 + NAME_MAX_LEN + SALT_LEN + Sha256::DIGEST_SIZE + 4];
+    uint16_t nameLen = static_cast<uint16_t>(name.size());
+
+    size_t pos = 0;
+    memcpy(rec + pos, &nameLen, 2);                     pos += 2;
+    memcpy(rec + pos, name.data(), nameLen);            pos += nameLen;
+    memcpy(rec + pos, salt, SALT_LEN);                  pos += SALT_LEN;
+    memcpy(rec + pos, digest, Sha256::DIGEST_SIZE);     pos += Sha256::DIGEST_SIZE;
+    uint32_t sum = checksum(rec, pos);
+    memcpy(rec + pos, &sum, 4);                         pos += 4;
+
+    if(write(m_logFd, rec, pos) != static_cast<ssize_t>(pos))
+    {
+        return false;
+    }
+
+    return fdatasync(m_logFd) == 0;
+}
+
+uint64_t MmapAuthStore::hashName(const string& name)
+{
+    uint64_t h = 14695981039346656037ull;
+    for(unsigned char c : name)
+    {
+        h = (h ^ c) * 1099511628211ull;
+    }
+    return h;
+}
+
+void MmapAuthStore::makeDigest(const uint8_t* salt, const string& pwd, uint8_t* digest)
+{
+    Sha256 sha;
+    sha.update(salt, SALT_LEN);
+    sha.update(pwd.data(), pwd.size());
+    sha.final(digest);
+}
+
+const MmapAuthStore::Slot* MmapAuthStore::find(const string& name, uint64_t h) const
+{
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = m_capacity - 1;
+
+    for(size_t i = 0, idx = h & mask; i < m_capacity; ++i, idx = (idx + 1) & mask)
+    {
+        const Slot& slot = m_slots[idx];
+        uint32_t state = std::atomic_ref<uint32_t>(const_cast<uint32_t&>(slot.state)).load(std::memory_order_acquire);
+        if(state == SLOT_EMPTY)
+        {
+            return nullptr;
+        }
+
+        if(slot.hash == tag && strncmp(slot.name, name.c_str(), NAME_MAX_LEN + 1) == 0)
+        {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+bool MmapAuthStore::insert(const string& name, uint64_t h, const uint8_t* salt, const uint8_t* digest)
+{
+    if(find(name, h))
+    {
+        return false;
+    }
+
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = m_capacity - 1;
+
+    for(size_t i = 0, idx = h & mask; i < m_capacity; ++i, idx = (idx + 1) & mask)
+    {
+        Slot& slot = m_slots[idx];
+        if(slot.state != SLOT_EMPTY)
+        {
+            continue;
+        }
+
+        // 先写数据，最后发布状态，读者看到 FULL 时数据一定完整
+        slot.hash = tag;
+        memset(slot.name, 0, sizeof(slot.name));
+        memcpy(slot.name, name.data(), name.size());
+        memcpy(slot.salt, salt, SALT_LEN);
+        memcpy(slot.digest, digest, Sha256::DIGEST_SIZE);
+        std::atomic_ref<uint32_t>(slot.state).store(SLOT_FULL, std::memory_order_release);
+
+        ++m_header->count;
+        return true;
+    }
+
+    return false;
+}
+
+AuthStore::RESULT MmapAuthStore::verify(const string& name, const string& pwd)
+{
+    if(!m_slots) return AUTH_ERROR;
+    if(name.size() > NAME_MAX_LEN) return AUTH_FAIL;
+
+    const Slot* slot = find(name, hashName(name));
+    if(slot == nullptr)
+    {
+        return AUTH_FAIL;
+    }
+
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    makeDigest(slot->salt, pwd, digest);
+    return memcmp(digest, slot->digest, sizeof(digest)) == 0 ? AUTH_OK : AUTH_FAIL;
+}
+
+AuthStore::RESULT MmapAuthStore::registerUser(const string& name, const string& pwd)
+{
+    if(!m_slots || name.empty() || name.size() > NAME_MAX_LEN)
+    {
+        return AUTH_ERROR;
+    }
+
+    uint64_t h = hashName(name);
+
+    uint8_t salt[SALT_LEN];
+    uint8_t digest[Sha256::DIGEST_SIZE];
+    {
+        thread_local std::mt19937_64 gen(std::random_device{}());
+        for(size_t i = 0; i < SALT_LEN; i += 8)
+        {
+            uint64_t v = gen();
+            memcpy(salt + i, &v, 8);
+        }
+    }
+    makeDigest(salt, pwd, digest);
+
+    std::lock_guard<std::mutex> locker(m_writeMtx);
+    // 进程间的写者用日志文件锁串行（升级期间新旧进程同时接受注册）
+    FileLock fileLock(m_logFd);
+    if(find(name, h))
+    {
+        return AUTH_DUPLICATE;
+    }
+
+    // 装载因子超过 0.9 拒绝写入，保证探测长度有界
+    if(m_header->count * 10 >= m_capacity * 9)
+    {
+        return AUTH_ERROR;
+    }
+
+    // 先落日志，再更新表
+    if(!appendLog(name, salt, digest))
+    {
+        return AUTH_ERROR;
+    }
+
+    return insert(name, h, salt, digest) ? AUTH_OK : AUTH_ERROR;
+}
+
+size_t MmapAuthStore::count() const
+{
+    return m_header ? m_header->count : 0;
+}
@@ -0,0 +1,102 @@
+#ifndef MMAPAUTHSTORE_H
+#define MMAPAUTHSTORE_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "authStore.h"
+#include "../utils/sha256.h"
+#include "../log/log.h"
+
+/**
+ *  内嵌用户表：内存映射的开放寻址哈希表 + 追加日志
+ *  - 表文件 <file>     : 文件头 + 定长槽位，线性探测，只增不删
+ *  - 日志文件 <file>.log : 每次注册先追加并 fdatasync，再写入表
+ *  - 读者无锁：槽位写完数据后再以 release 语义发布状态；写者之间用互斥锁串行，
+ *    跨进程（不停机升级期间）再加日志文件的 flock
+ *  - 非正常退出（文件头未标记 clean）时由日志重建整张表
+ */
+class MmapAuthStore : public AuthStore
+{
+public:
+    MmapAuthStore(const string& path, size_t capacity);
+    ~MmapAuthStore() override;
+
+    RESULT verify(const string& name, const string& pwd) override;
+    RESULT registerUser(const string& name, const string& pwd) override;
+
+    size_t count() const;
+
+private:
+    static const size_t NAME_MAX_LEN = 47;
+    static const size_t SALT_LEN = 16;
+
+    enum SLOT_STATE : uint32_t
+    {
+        SLOT_EMPTY = 0,
+        SLOT_FULL = 1,
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t clean;             // 1 表示上次正常关闭
+        uint64_t capacity;
+        uint64_t count;
+        uint8_t reserved[32];
+    };
+
+    struct Slot
+    {
+        uint32_t state;             // 通过 std::atomic_ref 访问
+        uint32_t hash;
+        char name[NAME_MAX_LEN + 1];
+        uint8_t salt[SALT_LEN];
+        uint8_t digest[Sha256::DIGEST_SIZE];
+        uint8_t pad[24];
+    };
+
+    /* 作用域内持有文件排他锁 */
+    struct FileLock
+    {
+        int fd;
+        explicit FileLock(int f) : fd(f) { flock(fd, LOCK_EX); }
+        ~FileLock() { flock(fd, LOCK_UN); }
+    };
+
+    bool openTable(bool& rebuild);
+    void closeTable();
+    bool openLog();
+    bool replayLog();
+    bool appendLog(const string& name, const uint8_t* salt, const uint8_t* digest);
+
+    const Slot* find(const string& name, uint64_t h) const;
+    bool insert(const string& name, uint64_t h, const uint8_t* salt, const uint8_t* digest);
+
+    static uint64_t hashName(const string& name);
+    static void makeDigest(const uint8_t* salt, const string& pwd, uint8_t* digest);
+
+private:
+    string m_path;
+    size_t m_capacity;          // 2 的幂
+
+    int m_tableFd;
+    int m_logFd;
+    size_t m_mapLen;
+    Header* m_header;
+    Slot* m_slots;
+
+    std::mutex m_writeMtx;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "mysqlAuthStore.h"
+
+AuthStore::RESULT MysqlAuthStore::verify(const string& name, const string& pwd)
+{
+    std::shared_ptr<MysqlConnection> mysql = DbConnsPool::getInstance()->getConnection();
+    if(!mysql)
+    {
+        return AUTH_ERROR;
+    }
+
+    // 预处理语句，参数以二进制方式绑定，不再拼接 SQL
+    if(!mysql->execute(MysqlConnection::STMT_SELECT_USER, {name}))
+    {
+#ifdef DEBUG
+        std::cout << "mysql query error!" << std::endl;
+#endif 
+        return AUTH_ERROR;
+    }
+
+    RESULT ret = AUTH_FAIL;
+    std::vector<string> row;
+    while(mysql->fetch(MysqlConnection::STMT_SELECT_USER, row))
+    {
+        ret = (pwd == row[1]) ? AUTH_OK : AUTH_FAIL;
+    }
+
+    return ret;
+}
+
+AuthStore::RESULT MysqlAuthStore::registerUser(const string& name, const string& pwd)
+{
+    // 注册走组提交，和同一时间段的其他注册合并成一个事务
+    switch(RegisterBatcher::getInstance()->submit(name, pwd))
+    {
+        case RegisterBatcher::REG_OK:
+            return AUTH_OK;
+        case RegisterBatcher::REG_DUPLICATE:
+            return AUTH_DUPLICATE;
+        default:
+            return AUTH_ERROR;
+    }
+}
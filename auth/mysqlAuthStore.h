@@ -0,0 +1,19 @@
+#ifndef MYSQLAUTHSTORE_H
+#define MYSQLAUTHSTORE_H
+
+#include "authStore.h"
+#include "registerBatcher.h"
+#include "../pool/sqlConnsPool/dbConnsPool.h"
+
+/* 基于 DbConnsPool 的 MySQL 实现：登录走预处理语句，注册走组提交 */
+class MysqlAuthStore : public AuthStore
+{
+public:
+    MysqlAuthStore() = default;
+    ~MysqlAuthStore() override = default;
+
+    RESULT verify(const string& name, const string& pwd) override;
+    RESULT registerUser(const string& name, const string& pwd) override;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "registerBatcher.h"
+
+RegisterBatcher* RegisterBatcher::getInstance()
+{
+    static RegisterBatcher batcher;
+    return &batcher;
+}
+
+RegisterBatcher::RegisterBatcher()
+:m_maxRows(64), m_windowMs(5), m_isRunning(true), m_watcher(nullptr)
+{
+    loadConfigFile();
+    m_maxRows = std::max(m_maxRows, 1);
+
+    m_flushThread = std::thread(std::bind(&RegisterBatcher::flushTask, this));
+}
+
+RegisterBatcher::~RegisterBatcher()
+{
+    m_isRunning = false;
+    m_cv.notify_all();
+
+    if(m_flushThread.joinable())
+    {
+        m_flushThread.join();
+    }
+}
+
+bool RegisterBatcher::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "connPool.conf";
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "regbatchsize")
+            {
+                m_maxRows = std::stoi(value);
+            }
+            else if(key == "regbatchwindow")
+            {
+                m_windowMs = std::stoi(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+bool RegisterBatcher::enqueue(Pending* req)
+{
+    std::lock_guard<std::mutex> locker(m_mtx);
+    if(!m_isRunning)
+    {
+        return false;
+    }
+    m_pending.push_back(req);
+
+    // 第一个请求唤醒攒批，攒满了立即提交
+    if(m_pending.size() == 1 || static_cast<int>(m_pending.size()) >= m_maxRows)
+    {
+        m_cv.notify_one();
+    }
+    return true;
+}
+
+RegisterBatcher::RESULT RegisterBatcher::submit(const string& name, const string& pwd)
+{
+    std::promise<RESULT> result;
+    std::future<RESULT> fut = result.get_future();
+    Pending req{name, pwd, [&result](RESULT ret){ result.set_value(ret); }};
+
+    if(!enqueue(&req))
+    {
+        return REG_ERROR;
+    }
+    return fut.get();
+}
+
+bool RegisterBatcher::SubmitAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    IoWatcher* watcher = m_batcher->m_watcher;
+    m_req.done = [this, h, watcher](RESULT ret){
+        m_result = ret;
+        if(watcher)
+        {
+            watcher->post(h);
+        }
+        else
+        {
+            h.resume();
+        }
+    };
+
+    // 已停止：不挂起，直接以 REG_ERROR 继续
+    return m_batcher->enqueue(&m_req);
+}
+
+void RegisterBatcher::flushTask()
+{
+    CpuAffinity::getInstance()->pin(CpuAffinity::DB);
+    std::vector<Pending*> batch;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_mtx);
+            m_cv.wait(locker, [this]{ return !m_pending.empty() || !m_isRunning; });
+
+            if(m_pending.empty() && !m_isRunning) break;
+
+            // 等待窗口期内的后续请求，攒满提前结束
+            m_cv.wait_for(locker, std::chrono::milliseconds(m_windowMs), [this]{
+                return static_cast<int>(m_pending.size()) >= m_maxRows || !m_isRunning;
+            });
+
+            size_t n = std::min(m_pending.size(), static_cast<size_t>(m_maxRows));
+            batch.assign(m_pending.begin(), m_pending.begin() + n);
+            m_pending.erase(m_pending.begin(), m_pending.begin() + n);
+        }
+
+        commitBatch(batch);
+        batch.clear();
+    }
+}
+
+void RegisterBatcher::commitBatch(std::vector<Pending*>& batch)
+{
+    std::vector<RESULT> results(batch.size(), REG_ERROR);
+
+    std::shared_ptr<MysqlConnection> mysql = DbConnsPool::getInstance()->getConnection();
+    if(mysql)
+    {
+        // 同一批次内的重复用户名，只有第一个有效
+        std::unordered_set<string> names;
+        std::vector<bool> insert(batch.size(), false);
+        string inList;
+        for(size_t i = 0; i < batch.size(); ++i)
+        {
+            if(!names.insert(batch[i]->name).second)
+            {
+                results[i] = REG_DUPLICATE;
+                continue;
+            }
+
+            insert[i] = true;
+            inList += (inList.empty() ? "'" : ",'") + mysql->escape(batch[i]->name) + "'";
+        }
+
+        bool ok = mysql->begin();
+
+        // 锁住已存在的用户名，标记为重复
+        std::unordered_set<string> exists;
+        if(ok)
+        {
+            MYSQL_RES* res = mysql->query("SELECT username FROM user WHERE username IN (" + inList + ") FOR UPDATE");
+            ok = (res != nullptr);
+            if(res)
+            {
+                while(MYSQL_ROW row = mysql_fetch_row(res))
+                {
+                    exists.insert(row[0]);
+                }
+                mysql_free_result(res);
+            }
+        }
+
+        // 剩下的行用一条多行 INSERT 发出（按行数缓存的预处理语句），整批只有一次执行和一次提交
+        std::vector<string> params;
+        size_t rows = 0;
+        for(size_t i = 0; ok && i < batch.size(); ++i)
+        {
+            if(!insert[i]) continue;
+            if(exists.count(batch[i]->name))
+            {
+                results[i] = REG_DUPLICATE;
+                insert[i] = false;
+                continue;
+            }
+
+            params.push_back(batch[i]->name);
+            params.push_back(batch[i]->pwd);
+            ++rows;
+        }
+        if(ok && rows > 0)
+        {
+            ok = mysql->execute(MysqlConnection::STMT_INSERT_USER, params, rows);
+        }
+        ok = ok && mysql->commit();
+
+        if(ok)
+        {
+            for(size_t i = 0; i < batch.size(); ++i)
+            {
+                if(insert[i]) results[i] = REG_OK;
+            }
+        }
+        else
+        {
+            mysql->rollback();
+            for(size_t i = 0; i < batch.size(); ++i)
+            {
+                if(insert[i]) results[i] = REG_ERROR;
+            }
+#ifdef DEBUG
+            std::cout << "register batch commit failed!" << std::endl;
+#endif
+            LOG_ERROR("register batch of %zu commit failed", batch.size());
+        }
+    }
+
+    for(size_t i = 0; i < batch.size(); ++i)
+    {
+        // 先取出回调：调用后等待的协程可能已在别的线程恢复并销毁 Pending
+        std::function<void(RESULT)> done = std::move(batch[i]->done);
+        done(results[i]);
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef REGISTERBATCHER_H
+#define REGISTERBATCHER_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <coroutine>
+
+#include "../pool/sqlConnsPool/dbConnsPool.h"
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  注册请求的组提交：攒够 N 行或等待几毫秒后，
+ *  在同一个事务中用一条多行预处理 INSERT 写入并一次提交，每个请求仍然拿到自己的结果
+ *  协程通过 submitAsync 挂起等待，提交完成后经 IoWatcher 投递回工作线程恢复，不占用线程
+ */
+class RegisterBatcher
+{
+public:
+    enum RESULT
+    {
+        REG_OK = 0,         // 注册成功
+        REG_DUPLICATE,      // 用户名已存在
+        REG_ERROR,          // 数据库错误
+    };
+
+public:
+    static RegisterBatcher* getInstance();
+    ~RegisterBatcher();
+
+    // 协程恢复的投递者，未设置时在提交线程上直接恢复
+    void setWatcher(IoWatcher* watcher) { m_watcher = watcher; }
+
+    // 阻塞直到所在批次提交完成
+    RESULT submit(const string& name, const string& pwd);
+
+private:
+    struct Pending
+    {
+        string name;
+        string pwd;
+        std::function<void(RESULT)> done;     // 提交线程调用，之后 Pending 可能立即失效
+    };
+
+public:
+    /* co_await 挂起到所在批次提交完成 */
+    class SubmitAwaiter
+    {
+    public:
+        SubmitAwaiter(RegisterBatcher* batcher, const string& name, const string& pwd)
+        :m_batcher(batcher), m_req{name, pwd, nullptr}, m_result(REG_ERROR) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h);
+        RESULT await_resume() const noexcept { return m_result; }
+
+    private:
+        RegisterBatcher* m_batcher;
+        Pending m_req;
+        RESULT m_result;
+    };
+
+    SubmitAwaiter submitAsync(const string& name, const string& pwd) { return SubmitAwaiter(this, name, pwd); }
+
+private:
+    RegisterBatcher();
+    bool loadConfigFile();
+
+    bool enqueue(Pending* req);
+    void flushTask();
+    void commitBatch(std::vector<Pending*>& batch);
+
+private:
+    int m_maxRows;              // 每批最多行数
+    int m_windowMs;             // 攒批等待时间，单位毫秒
+    string m_configPath;
+
+    std::vector<Pending*> m_pending;
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+
+    std::atomic<bool> m_isRunning;
+    std::thread m_flushThread;
+    IoWatcher* m_watcher;
+};
+
+#endif
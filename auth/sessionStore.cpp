@@ -0,0 +1,196 @@
+#include "sessionStore.h"
+
+const char* SessionStore::COOKIE_NAME = "sid";
+
+SessionStore* SessionStore::getInstance()
+{
+    static SessionStore store;
+    return &store;
+}
+
+SessionStore::SessionStore()
+:m_enable(true), m_shardNum(16), m_ttl(1800)
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "SessionStore use default configuration..." << std::endl;
+#endif
+    }
+
+    m_shardNum = std::max(m_shardNum, 1);
+    for(int i = 0; i < m_shardNum; ++i)
+    {
+        m_shards.emplace_back(new Shard);
+    }
+}
+
+bool SessionStore::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "session.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << m_configPath << std::endl;
+#endif
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "enable")
+            {
+                m_enable = std::stoi(value) != 0;
+            }
+            else if(key == "shards")
+            {
+                m_shardNum = std::stoi(value);
+            }
+            else if(key == "ttl")
+            {
+                m_ttl = std::stoi(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+SessionStore::Shard& SessionStore::shardOf(const string& token)
+{
+    return *m_shards[std::hash<string>()(token) % m_shards.size()];
+}
+
+string SessionStore::makeToken()
+{
+    // 128 位随机数，内核 CSPRNG
+    unsigned char raw[16];
+    ssize_t n = 0;
+    while(n < static_cast<ssize_t>(sizeof(raw)))
+    {
+        ssize_t ret = getrandom(raw + n, sizeof(raw) - n, 0);
+        if(ret < 0) return "";
+        n += ret;
+    }
+
+    static const char HEX[] = "0123456789abcdef";
+    string token(sizeof(raw) * 2, '0');
+    for(size_t i = 0; i < sizeof(raw); ++i)
+    {
+        token[i * 2] = HEX[raw[i] >> 4];
+        token[i * 2 + 1] = HEX[raw[i] & 0x0f];
+    }
+    return token;
+}
+
+string SessionStore::create(const string& user)
+{
+    if(!m_enable) return "";
+
+    string token = makeToken();
+    if(token.empty()) return "";
+
+    Shard& shard = shardOf(token);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+
+    int id = shard.nextId++;
+    shard.sessions[token] = Session{user};
+    shard.tokens[id] = token;
+
+    // 到期回调在 tickShard() 中、持有分片锁时执行
+    Shard* sp = &shard;
+    shard.timer.add(id, m_ttl * 1000, [sp, id]{
+        auto it = sp->tokens.find(id);
+        if(it != sp->tokens.end())
+        {
+            sp->sessions.erase(it->second);
+            sp->tokens.erase(it);
+        }
+    });
+    tickShard(shard, nowMs());
+
+    return token;
+}
+
+bool SessionStore::lookup(const string& token, string* user)
+{
+    if(!m_enable || token.empty()) return false;
+
+    Shard& shard = shardOf(token);
+    std::lock_guard<std::mutex> locker(shard.mtx);
+
+    auto it = shard.sessions.find(token);
+    if(it == shard.sessions.end())
+    {
+        return false;
+    }
+
+    if(user) *user = it->second.user;
+    return true;
+}
+
+int64_t SessionStore::nowMs()
+{
+    // 与 MinHeapTimer 使用同一个时钟
+    return std::chrono::duration_cast<MS>(Clock::now().time_since_epoch()).count();
+}
+
+void SessionStore::tickShard(Shard& shard, int64_t now)
+{
+    int t = shard.timer.getNextTick();
+    shard.nextExpire.store(t < 0 ? 0 : now + std::max(t, 1), std::memory_order_release);
+}
+
+int SessionStore::getNextTick()
+{
+    if(!m_enable) return -1;
+
+    int64_t now = nowMs();
+    int64_t next = -1;
+    for(auto& shard : m_shards)
+    {
+        // 只有到期的分片才加锁处理，其余只读原子量
+        int64_t expire = shard->nextExpire.load(std::memory_order_acquire);
+        if(expire != 0 && expire <= now)
+        {
+            std::lock_guard<std::mutex> locker(shard->mtx);
+            tickShard(*shard, now);
+            expire = shard->nextExpire.load(std::memory_order_relaxed);
+        }
+
+        if(expire != 0 && (next < 0 || expire - now < next))
+        {
+            next = expire - now;
+        }
+    }
+    return static_cast<int>(next);
+}
+
+size_t SessionStore::size()
+{
+    size_t total = 0;
+    for(auto& shard : m_shards)
+    {
+        std::lock_guard<std::mutex> locker(shard->mtx);
+        total += shard->sessions.size();
+    }
+    return total;
+}
@@ -0,0 +1,78 @@
+#ifndef SESSIONSTORE_H
+#define SESSIONSTORE_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+#include <sys/random.h>
+
+#include "../timer/minHeapTimer.h"
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  登录会话：登录成功后下发随机令牌（Cookie: sid=...），之后凭令牌一次哈希查找即可认证
+ *  - 按令牌分片，每个分片一把锁
+ *  - 过期由分片内的 MinHeapTimer 驱动，反应堆每轮循环调用 getNextTick()；
+ *    各分片的最近到期时间另存一份原子量，没有到期的分片不加锁
+ */
+class SessionStore
+{
+public:
+    static SessionStore* getInstance();
+
+    bool isEnable() const { return m_enable; }
+    int ttl() const { return m_ttl; }
+
+    // 创建会话，返回令牌；未启用时返回空串
+    string create(const string& user);
+    bool lookup(const string& token, string* user = nullptr);
+
+    // 处理到期的会话，返回距下一个会话到期的毫秒数，没有会话返回 -1
+    int getNextTick();
+    size_t size();
+
+public:
+    static const char* COOKIE_NAME;
+
+private:
+    SessionStore();
+    bool loadConfigFile();
+
+    struct Session
+    {
+        string user;
+    };
+
+    struct Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<string, Session> sessions;   // 令牌 -> 会话
+        std::unordered_map<int, string> tokens;         // 定时器 id -> 令牌
+        MinHeapTimer timer;
+        int nextId = 0;
+        std::atomic<int64_t> nextExpire{0};             // 最近到期的时刻（毫秒），0 为没有会话
+    };
+
+    Shard& shardOf(const string& token);
+    static int64_t nowMs();
+    // 持有分片锁时调用：处理到期的会话并更新 nextExpire
+    static void tickShard(Shard& shard, int64_t now);
+    static string makeToken();
+
+private:
+    bool m_enable;
+    int m_shardNum;
+    int m_ttl;                  // 会话有效期，单位：秒
+    string m_configPath;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# 低延迟模式对比：同一场景分别在普通模式、忙轮询、忙轮询 + 反应堆就地处理下压测，每行一个 JSON。
+# 除 loadgen 的延迟分位数外，附服务进程在压测期间的 CPU 占用（cpu_pct，100 为一个核）
+# 和每个请求消耗的 CPU 时间（cpu_us_per_req），用来衡量换取延迟的代价。
+#
+# 用法: bench/busypoll.sh [webserver] [loadgen]
+# 环境变量: PORT DURATION BUSY_POLL OUT
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+PORT=${PORT:-9090}
+DURATION=${DURATION:-10}
+BUSY_POLL=${BUSY_POLL:-200}
+OUT=${OUT:-bench_busypoll.jsonl}
+
+CONF=config/server.conf
+BACKUP=$(mktemp)
+cp "$CONF" "$BACKUP"
+
+SERVER_PID=
+cleanup()
+{
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    cp "$BACKUP" "$CONF"
+    rm -f "$BACKUP"
+}
+trap cleanup EXIT
+
+HZ=$(getconf CLK_TCK)
+
+# 进程累计 CPU 时间（utime + stime，单位为时钟滴答）
+cpu_ticks()
+{
+    awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+set_conf()
+{
+    sed -i "s/^$1=.*/$1=$2/" "$CONF"
+}
+
+# 名称|ioMode|busyPoll|inlineRequests
+MODES=(
+    "baseline|pool|0|0"
+    "busypoll|pool|$BUSY_POLL|0"
+    "busypoll_inline|pool|$BUSY_POLL|1"
+    "reactor|reactor|0|0"
+    "reactor_busypoll_inline|reactor|$BUSY_POLL|1"
+)
+
+# 名称|连接数|请求类型
+SCENARIOS=(
+    "serial|1|get:100"
+    "light|8|get:100"
+    "mixed|8|get:90,login:10"
+)
+
+: > "$OUT"
+for m in "${MODES[@]}"; do
+    IFS='|' read -r mode io busy inline <<< "$m"
+    set_conf ioMode "$io"
+    set_conf busyPoll "$busy"
+    set_conf inlineRequests "$inline"
+
+    "$SERVER" -p "$PORT" -m 3 >/dev/null 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 1 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+        sleep 0.1
+    done
+
+    for s in "${SCENARIOS[@]}"; do
+        IFS='|' read -r name conns mix <<< "$s"
+        start=$(cpu_ticks "$SERVER_PID")
+        result=$("$LOADGEN" -p "$PORT" -c "$conns" -d "$DURATION" -k 1 -m "$mix")
+        ticks=$(( $(cpu_ticks "$SERVER_PID") - start ))
+        requests=$(echo "$result" | grep -o '"requests":[0-9]*' | cut -d: -f2)
+
+        line=$(awk -v m="$mode" -v s="$name" -v t="$ticks" -v hz="$HZ" -v d="$DURATION" -v n="${requests:-0}" -v r="$result" \
+            'BEGIN { printf "{\"mode\":\"%s\",\"scenario\":\"%s\",\"cpu_pct\":%.1f,\"cpu_us_per_req\":%.1f,\"result\":%s}",
+                     m, s, t * 100 / hz / d, (n > 0 ? t * 1e6 / hz / n : 0), r }')
+        echo "$line" | tee -a "$OUT"
+    done
+
+    kill "$SERVER_PID" 2>/dev/null
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=
+done
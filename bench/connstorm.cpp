@@ -0,0 +1,306 @@
+/**
+ *  连接风暴压测：保持固定数量的在途建连，每个连接发一个短连接请求（或只建连），
+ *  统计每秒建连数、建连/完成延迟，以及疑似 SYN 被丢弃后重传的慢建连（>= 1s）
+ *
+ *  用法: connstorm [-h host] [-p port] [-c inflight] [-d seconds] [-u path] [-n]
+ *        -n 只建连不发请求，连接建立后立即 RST 关闭
+ */
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+using std::string;
+
+namespace
+{
+
+struct Options
+{
+    string host = "127.0.0.1";
+    int port = 9090;
+    int inflight = 512;
+    int duration = 10;
+    string path = "/index.html";
+    bool connectOnly = false;
+};
+
+struct Slot
+{
+    int fd = -1;
+    bool connected = false;
+    uint64_t startUs = 0;
+    size_t sent = 0;
+    size_t received = 0;
+};
+
+struct Stats
+{
+    uint64_t attempts = 0;
+    uint64_t established = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t slowConnects = 0;          // 建连耗时 >= 1s，通常是 SYN 或 ACK 被丢弃后重传
+    std::vector<uint32_t> connectUs;
+    std::vector<uint32_t> totalUs;
+};
+
+const uint64_t SLOW_CONNECT_US = 1000000;
+
+Options g_opt;
+Stats g_stats;
+sockaddr_in g_addr;
+string g_request;
+int g_epfd = -1;
+
+uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void closeSlot(Slot& s, bool reset)
+{
+    if(s.fd >= 0)
+    {
+        if(reset)
+        {
+            // 客户端先关闭会留下 TIME_WAIT，高速建连时很快耗尽本地端口
+            struct linger lg = { 1, 0 };
+            setsockopt(s.fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        }
+        epoll_ctl(g_epfd, EPOLL_CTL_DEL, s.fd, nullptr);
+        close(s.fd);
+    }
+    s = Slot();
+}
+
+bool openSlot(Slot& s, int idx)
+{
+    s.startUs = nowUs();
+    ++g_stats.attempts;
+
+    s.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(s.fd < 0)
+    {
+        ++g_stats.failed;
+        return false;
+    }
+
+    int ret = connect(s.fd, reinterpret_cast<sockaddr*>(&g_addr), sizeof(g_addr));
+    if(ret < 0 && errno != EINPROGRESS)
+    {
+        ++g_stats.failed;
+        closeSlot(s, true);
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLOUT;
+    ev.data.u32 = idx;
+    epoll_ctl(g_epfd, EPOLL_CTL_ADD, s.fd, &ev);
+    return true;
+}
+
+void record(std::vector<uint32_t>& v, uint64_t us)
+{
+    v.push_back(static_cast<uint32_t>(std::min<uint64_t>(us, UINT32_MAX)));
+}
+
+/* 返回 false 表示该槽位已结束（成功或失败），需要重新建连 */
+bool onEvent(Slot& s, int idx, uint32_t events)
+{
+    if(!s.connected)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(s.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if(err != 0 || (events & EPOLLERR))
+        {
+            ++g_stats.failed;
+            closeSlot(s, true);
+            return false;
+        }
+
+        uint64_t cost = nowUs() - s.startUs;
+        s.connected = true;
+        ++g_stats.established;
+        record(g_stats.connectUs, cost);
+        if(cost >= SLOW_CONNECT_US) ++g_stats.slowConnects;
+
+        if(g_opt.connectOnly)
+        {
+            ++g_stats.completed;
+            record(g_stats.totalUs, cost);
+            closeSlot(s, true);
+            return false;
+        }
+
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u32 = idx;
+        epoll_ctl(g_epfd, EPOLL_CTL_MOD, s.fd, &ev);
+    }
+
+    if((events & EPOLLOUT) && s.sent < g_request.size())
+    {
+        ssize_t n = send(s.fd, g_request.data() + s.sent, g_request.size() - s.sent, MSG_NOSIGNAL);
+        if(n < 0 && errno != EAGAIN)
+        {
+            ++g_stats.failed;
+            closeSlot(s, true);
+            return false;
+        }
+        if(n > 0) s.sent += n;
+        if(s.sent == g_request.size())
+        {
+            epoll_event ev = {};
+            ev.events = EPOLLIN;
+            ev.data.u32 = idx;
+            epoll_ctl(g_epfd, EPOLL_CTL_MOD, s.fd, &ev);
+        }
+    }
+
+    if(events & (EPOLLIN | EPOLLHUP))
+    {
+        char buf[65536];
+        while(true)
+        {
+            ssize_t n = recv(s.fd, buf, sizeof(buf), 0);
+            if(n > 0)
+            {
+                s.received += n;
+                continue;
+            }
+            if(n < 0 && errno == EAGAIN) break;
+
+            // 服务端发完响应后关闭（Connection: close），读到 EOF 即完成
+            if(n == 0 && s.received > 0)
+            {
+                ++g_stats.completed;
+                record(g_stats.totalUs, nowUs() - s.startUs);
+            }
+            else
+            {
+                ++g_stats.failed;
+            }
+            closeSlot(s, n != 0);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t percentile(std::vector<uint32_t>& v, double q)
+{
+    if(v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+    return v[idx];
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while((opt = getopt(argc, argv, "h:p:c:d:u:n")) != -1)
+    {
+        switch(opt)
+        {
+            case 'h': g_opt.host = optarg; break;
+            case 'p': g_opt.port = atoi(optarg); break;
+            case 'c': g_opt.inflight = std::max(1, atoi(optarg)); break;
+            case 'd': g_opt.duration = std::max(1, atoi(optarg)); break;
+            case 'u': g_opt.path = optarg; break;
+            case 'n': g_opt.connectOnly = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-p port] [-c inflight] [-d seconds] [-u path] [-n]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    g_addr = {};
+    g_addr.sin_family = AF_INET;
+    g_addr.sin_port = htons(g_opt.port);
+    if(inet_pton(AF_INET, g_opt.host.c_str(), &g_addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad host %s\n", g_opt.host.c_str());
+        return 1;
+    }
+
+    g_request = "GET " + g_opt.path + " HTTP/1.1\r\nHost: " + g_opt.host + "\r\n"
+        "User-Agent: connstorm\r\nConnection: close\r\n\r\n";
+
+    g_epfd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Slot> slots(g_opt.inflight);
+
+    uint64_t start = nowUs();
+    uint64_t end = start + static_cast<uint64_t>(g_opt.duration) * 1000000;
+
+    std::vector<int> idle;              // 建连失败（如本地端口耗尽）待重试的槽位
+    for(int i = 0; i < g_opt.inflight; ++i)
+    {
+        if(!openSlot(slots[i], i)) idle.push_back(i);
+    }
+
+    std::vector<epoll_event> events(1024);
+    while(nowUs() < end)
+    {
+        int n = epoll_wait(g_epfd, events.data(), static_cast<int>(events.size()), 10);
+        for(int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            Slot& s = slots[idx];
+            if(s.fd < 0) continue;
+
+            if(!onEvent(s, idx, events[i].events) && !openSlot(s, idx))
+            {
+                idle.push_back(idx);
+            }
+        }
+
+        std::vector<int> retry;
+        retry.swap(idle);
+        for(int idx : retry)
+        {
+            if(!openSlot(slots[idx], idx)) idle.push_back(idx);
+        }
+    }
+
+    double elapsed = (nowUs() - start) / 1e6;
+    for(Slot& s : slots)
+    {
+        closeSlot(s, true);
+    }
+    close(g_epfd);
+
+    std::sort(g_stats.connectUs.begin(), g_stats.connectUs.end());
+    std::sort(g_stats.totalUs.begin(), g_stats.totalUs.end());
+
+    printf("{\"inflight\":%d,\"duration_s\":%.3f,\"request\":\"%s\","
+        "\"attempts\":%llu,\"established\":%llu,\"completed\":%llu,\"failed\":%llu,\"slow_connects\":%llu,"
+        "\"cps\":%.1f,\"connect_us\":{\"p50\":%u,\"p99\":%u,\"max\":%u},\"total_us\":{\"p50\":%u,\"p99\":%u,\"max\":%u}}\n",
+        g_opt.inflight, elapsed, g_opt.connectOnly ? "" : g_opt.path.c_str(),
+        (unsigned long long)g_stats.attempts, (unsigned long long)g_stats.established,
+        (unsigned long long)g_stats.completed, (unsigned long long)g_stats.failed,
+        (unsigned long long)g_stats.slowConnects,
+        g_stats.established / elapsed,
+        percentile(g_stats.connectUs, 0.50), percentile(g_stats.connectUs, 0.99),
+        g_stats.connectUs.empty() ? 0 : g_stats.connectUs.back(),
+        percentile(g_stats.totalUs, 0.50), percentile(g_stats.totalUs, 0.99),
+        g_stats.totalUs.empty() ? 0 : g_stats.totalUs.back());
+
+    return 0;
+}
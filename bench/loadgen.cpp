@@ -0,0 +1,467 @@
+/**
+ *  基于 epoll 的 HTTP 压测工具
+ *  - 可配置并发连接数、长连接、流水线深度
+ *  - 请求混合：静态资源 GET + 登录/注册 POST
+ *  - 结束后以 JSON 输出 requests/s 和 p50/p99/p999 延迟
+ *
+ *  用法: loadgen [-h host] [-p port] [-c conns] [-d seconds] [-k keepalive(0/1)]
+ *               [-P pipeline] [-m get:80,login:10,register:10] [-u paths] [-U unixPath]
+ *        -U 经 Unix 域套接字连接（忽略 -h/-p 的地址，Host 头仍用 -h）
+ */
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+using std::string;
+
+namespace
+{
+
+struct Options
+{
+    string host = "127.0.0.1";
+    int port = 9090;
+    string unixPath;                    // 非空时走 AF_UNIX
+    int conns = 64;
+    int duration = 10;
+    bool keepAlive = true;
+    int pipeline = 1;
+    int getWeight = 100;
+    int loginWeight = 0;
+    int registerWeight = 0;
+    std::vector<string> paths = {
+        "/index.html", "/login.html", "/register.html", "/picture.html",
+        "/css/style.css", "/js/custom.js", "/images/profile-image.jpg",
+    };
+};
+
+enum REQ_KIND { REQ_GET = 0, REQ_LOGIN, REQ_REGISTER };
+
+struct Conn
+{
+    int fd = -1;
+    bool connected = false;
+    string out;                         // 待发送数据
+    size_t outOff = 0;
+    string in;                          // 已接收未解析的数据
+    std::deque<uint64_t> sentAt;        // 每个在途请求的发送时间（微秒）
+    bool closeAfter = false;            // 服务端要求关闭
+};
+
+struct Stats
+{
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    uint64_t connects = 0;
+    uint64_t bytesIn = 0;
+    std::vector<uint32_t> latencies;
+    std::map<int, uint64_t> status;
+};
+
+Options g_opt;
+Stats g_stats;
+sockaddr_storage g_addr;
+socklen_t g_addrLen = 0;
+std::mt19937 g_rng(12345);
+uint64_t g_userSeq = 0;
+uint64_t g_registered = 0;
+int g_epfd = -1;
+
+uint64_t nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+string buildRequest()
+{
+    int total = g_opt.getWeight + g_opt.loginWeight + g_opt.registerWeight;
+    int r = static_cast<int>(g_rng() % std::max(total, 1));
+    const char* conn = g_opt.keepAlive ? "keep-alive" : "close";
+
+    if(r < g_opt.getWeight)
+    {
+        const string& path = g_opt.paths[g_rng() % g_opt.paths.size()];
+        return "GET " + path + " HTTP/1.1\r\nHost: " + g_opt.host + "\r\n"
+            "User-Agent: loadgen\r\nAccept: */*\r\nConnection: " + conn + "\r\n\r\n";
+    }
+
+    string path;
+    string body;
+    if(r < g_opt.getWeight + g_opt.loginWeight)
+    {
+        uint64_t id = g_registered ? g_rng() % g_registered : 0;
+        path = "/login.html";
+        body = "username=bench" + std::to_string(getpid()) + "_" + std::to_string(id) + "&password=pw" + std::to_string(id);
+    }
+    else
+    {
+        uint64_t id = g_userSeq++;
+        path = "/register.html";
+        body = "username=bench" + std::to_string(getpid()) + "_" + std::to_string(id) + "&password=pw" + std::to_string(id);
+        g_registered = g_userSeq;
+    }
+
+    return "POST " + path + " HTTP/1.1\r\nHost: " + g_opt.host + "\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: " + conn + "\r\n\r\n" + body;
+}
+
+void closeConn(Conn& c)
+{
+    if(c.fd >= 0)
+    {
+        epoll_ctl(g_epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+        close(c.fd);
+    }
+    c.fd = -1;
+    c.connected = false;
+    c.out.clear();
+    c.outOff = 0;
+    c.in.clear();
+    c.closeAfter = false;
+    // 在途请求视为失败
+    g_stats.errors += c.sentAt.size();
+    c.sentAt.clear();
+}
+
+bool openConn(Conn& c, int idx)
+{
+    c.fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(c.fd < 0) return false;
+
+    if(g_addr.ss_family == AF_INET)
+    {
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    int ret = connect(c.fd, reinterpret_cast<sockaddr*>(&g_addr), g_addrLen);
+    if(ret < 0 && errno != EINPROGRESS)
+    {
+        close(c.fd);
+        c.fd = -1;
+        return false;
+    }
+
+    ++g_stats.connects;
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.u32 = idx;
+    epoll_ctl(g_epfd, EPOLL_CTL_ADD, c.fd, &ev);
+    return true;
+}
+
+void fillPipeline(Conn& c)
+{
+    // 非长连接每个连接只发一个请求
+    int depth = g_opt.keepAlive ? g_opt.pipeline : 1;
+    uint64_t now = nowUs();
+    while(static_cast<int>(c.sentAt.size()) < depth)
+    {
+        c.out += buildRequest();
+        c.sentAt.push_back(now);
+        if(!g_opt.keepAlive) break;
+    }
+}
+
+bool flushOut(Conn& c, int idx)
+{
+    while(c.outOff < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if(n < 0)
+        {
+            if(errno == EAGAIN) break;
+            return false;
+        }
+        c.outOff += n;
+    }
+
+    if(c.outOff == c.out.size())
+    {
+        c.out.clear();
+        c.outOff = 0;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | (c.out.empty() ? 0 : EPOLLOUT);
+    ev.data.u32 = idx;
+    epoll_ctl(g_epfd, EPOLL_CTL_MOD, c.fd, &ev);
+    return true;
+}
+
+// 解析一个完整响应，返回消耗的字节数，不完整返回 0，格式错误返回 -1
+long parseResponse(Conn& c, int* status)
+{
+    size_t hdrEnd = c.in.find("\r\n\r\n");
+    if(hdrEnd == string::npos) return 0;
+
+    if(c.in.compare(0, 5, "HTTP/") != 0) return -1;
+    size_t sp = c.in.find(' ');
+    *status = atoi(c.in.c_str() + sp + 1);
+
+    string headers = c.in.substr(0, hdrEnd);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+    long bodyLen = 0;
+    size_t pos = headers.find("content-length:");
+    if(pos != string::npos)
+    {
+        bodyLen = atol(headers.c_str() + pos + 15);
+    }
+    if(headers.find("connection: close") != string::npos)
+    {
+        c.closeAfter = true;
+    }
+
+    size_t total = hdrEnd + 4 + bodyLen;
+    if(c.in.size() < total) return 0;
+    return static_cast<long>(total);
+}
+
+bool onReadable(Conn& c)
+{
+    char buf[65536];
+    bool alive = true;
+    while(true)
+    {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if(n > 0)
+        {
+            g_stats.bytesIn += n;
+            c.in.append(buf, n);
+            continue;
+        }
+        // 对端关闭前发来的响应仍要统计
+        if(n < 0 && errno == EAGAIN) break;
+        alive = false;
+        break;
+    }
+
+    while(!c.sentAt.empty())
+    {
+        int status = 0;
+        long used = parseResponse(c, &status);
+        if(used < 0) return false;
+        if(used == 0) break;
+
+        g_stats.latencies.push_back(static_cast<uint32_t>(std::min<uint64_t>(nowUs() - c.sentAt.front(), UINT32_MAX)));
+        ++g_stats.requests;
+        ++g_stats.status[status];
+        c.sentAt.pop_front();
+        c.in.erase(0, used);
+    }
+
+    return alive;
+}
+
+uint32_t percentile(std::vector<uint32_t>& v, double q)
+{
+    if(v.empty()) return 0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(q * v.size()));
+    return v[idx];
+}
+
+void parseMix(const string& mix)
+{
+    g_opt.getWeight = g_opt.loginWeight = g_opt.registerWeight = 0;
+    size_t pos = 0;
+    while(pos < mix.size())
+    {
+        size_t end = mix.find(',', pos);
+        if(end == string::npos) end = mix.size();
+        string item = mix.substr(pos, end - pos);
+        size_t colon = item.find(':');
+        int w = colon == string::npos ? 1 : atoi(item.c_str() + colon + 1);
+        string kind = item.substr(0, colon);
+        if(kind == "get") g_opt.getWeight = w;
+        else if(kind == "login") g_opt.loginWeight = w;
+        else if(kind == "register") g_opt.registerWeight = w;
+        pos = end + 1;
+    }
+}
+
+void parsePaths(const string& list)
+{
+    g_opt.paths.clear();
+    size_t pos = 0;
+    while(pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if(end == string::npos) end = list.size();
+        if(end > pos) g_opt.paths.push_back(list.substr(pos, end - pos));
+        pos = end + 1;
+    }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while((opt = getopt(argc, argv, "h:p:c:d:k:P:m:u:U:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'h': g_opt.host = optarg; break;
+            case 'p': g_opt.port = atoi(optarg); break;
+            case 'c': g_opt.conns = std::max(1, atoi(optarg)); break;
+            case 'd': g_opt.duration = std::max(1, atoi(optarg)); break;
+            case 'k': g_opt.keepAlive = atoi(optarg) != 0; break;
+            case 'P': g_opt.pipeline = std::max(1, atoi(optarg)); break;
+            case 'm': parseMix(optarg); break;
+            case 'u': parsePaths(optarg); break;
+            case 'U': g_opt.unixPath = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-h host] [-p port] [-c conns] [-d seconds] [-k 0|1] [-P depth] "
+                    "[-m get:80,login:10,register:10] [-u path1,path2] [-U unixPath]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(g_opt.paths.empty())
+    {
+        fprintf(stderr, "no paths\n");
+        return 1;
+    }
+
+    g_addr = {};
+    if(!g_opt.unixPath.empty())
+    {
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&g_addr);
+        if(g_opt.unixPath.size() >= sizeof(un->sun_path))
+        {
+            fprintf(stderr, "unix path too long %s\n", g_opt.unixPath.c_str());
+            return 1;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, g_opt.unixPath.c_str(), g_opt.unixPath.size() + 1);
+        g_addrLen = sizeof(sockaddr_un);
+    }
+    else
+    {
+        sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&g_addr);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(g_opt.port);
+        if(inet_pton(AF_INET, g_opt.host.c_str(), &in->sin_addr) != 1)
+        {
+            fprintf(stderr, "bad host %s\n", g_opt.host.c_str());
+            return 1;
+        }
+        g_addrLen = sizeof(sockaddr_in);
+    }
+
+    g_epfd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Conn> conns(g_opt.conns);
+    for(int i = 0; i < g_opt.conns; ++i)
+    {
+        if(openConn(conns[i], i))
+        {
+            fillPipeline(conns[i]);
+        }
+    }
+
+    std::vector<epoll_event> events(1024);
+    uint64_t start = nowUs();
+    uint64_t end = start + static_cast<uint64_t>(g_opt.duration) * 1000000;
+
+    while(true)
+    {
+        uint64_t now = nowUs();
+        if(now >= end) break;
+
+        int n = epoll_wait(g_epfd, events.data(), static_cast<int>(events.size()), 10);
+        for(int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            Conn& c = conns[idx];
+            if(c.fd < 0) continue;
+
+            bool ok = true;
+            if(events[i].events & EPOLLERR)
+            {
+                ok = false;
+            }
+            if(ok && (events[i].events & EPOLLOUT) && !(events[i].events & EPOLLHUP))
+            {
+                c.connected = true;
+                ok = flushOut(c, idx);
+            }
+            // Unix 域套接字对端发完响应后关闭时 EPOLLHUP 与 EPOLLIN 同时到达，先读完已到的响应
+            if(ok && (events[i].events & EPOLLIN))
+            {
+                ok = onReadable(c);
+            }
+            if(events[i].events & EPOLLHUP)
+            {
+                ok = false;
+            }
+
+            if(!ok || (c.closeAfter && c.sentAt.empty()))
+            {
+                closeConn(c);
+                if(openConn(c, idx))
+                {
+                    fillPipeline(c);
+                }
+                continue;
+            }
+
+            // 本批响应全部到齐，发下一批
+            if(c.sentAt.empty())
+            {
+                fillPipeline(c);
+                flushOut(c, idx);
+            }
+        }
+    }
+
+    double elapsed = (nowUs() - start) / 1e6;
+    for(Conn& c : conns)
+    {
+        if(c.fd >= 0) close(c.fd);
+    }
+    close(g_epfd);
+
+    std::sort(g_stats.latencies.begin(), g_stats.latencies.end());
+
+    printf("{\"transport\":\"%s\",\"connections\":%d,\"keepalive\":%d,\"pipeline\":%d,\"duration_s\":%.3f,"
+        "\"mix\":{\"get\":%d,\"login\":%d,\"register\":%d},"
+        "\"requests\":%llu,\"errors\":%llu,\"connects\":%llu,\"bytes_in\":%llu,\"rps\":%.1f,"
+        "\"latency_us\":{\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u},\"status\":{",
+        g_opt.unixPath.empty() ? "tcp" : "unix", g_opt.conns, g_opt.keepAlive ? 1 : 0, g_opt.pipeline, elapsed,
+        g_opt.getWeight, g_opt.loginWeight, g_opt.registerWeight,
+        (unsigned long long)g_stats.requests, (unsigned long long)g_stats.errors,
+        (unsigned long long)g_stats.connects, (unsigned long long)g_stats.bytesIn,
+        g_stats.requests / elapsed,
+        percentile(g_stats.latencies, 0.50), percentile(g_stats.latencies, 0.99),
+        percentile(g_stats.latencies, 0.999), g_stats.latencies.empty() ? 0 : g_stats.latencies.back());
+
+    bool first = true;
+    for(auto& it : g_stats.status)
+    {
+        printf("%s\"%d\":%llu", first ? "" : ",", it.first, (unsigned long long)it.second);
+        first = false;
+    }
+    printf("}}\n");
+
+    return 0;
+}
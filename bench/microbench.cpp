@@ -0,0 +1,449 @@
+/**
+ *  核心数据结构微基准
+ *  - Buffer       : insert、socketpair 上的 readFromFd、扩容/搬移（_makeSpace）模式
+ *  - HttpRequest  : 解析真实浏览器请求
+ *  - MinHeapTimer : 10k ~ 1M 规模下的 add / adjust / tick
+ *  - ThreadsPool  : 提交到执行的延迟、吞吐
+ *  - Log          : 请求线程写一条访问日志的开销
+ *
+ *  每个用例输出一行 JSON，便于不同提交之间 diff 回归。
+ *  用法: microbench [-f 名称过滤子串] [-q]（-q 为快速模式，规模缩小 10 倍）
+ */
+#include <sys/socket.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "buffer.h"
+#include "httpRequest.h"
+#include "minHeapTimer.h"
+#include "threadsPool.h"
+#include "log.h"
+
+using std::string;
+
+namespace
+{
+
+string g_filter;
+int g_scale = 1;
+
+using BenchClock = std::chrono::steady_clock;
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now().time_since_epoch()).count();
+}
+
+bool enabled(const char* name)
+{
+    return g_filter.empty() || strstr(name, g_filter.c_str()) != nullptr;
+}
+
+// 一组用例（如 timer_*）中是否有任一用例被选中
+bool groupEnabled(const char* prefix)
+{
+    return enabled(prefix) || strncmp(g_filter.c_str(), prefix, strlen(prefix)) == 0;
+}
+
+// 阻止编译器把被测代码优化掉
+template<typename T>
+void keep(const T& v)
+{
+    asm volatile("" : : "g"(&v) : "memory");
+}
+
+void report(const char* name, const string& param, uint64_t ops, uint64_t ns, const string& extra = "")
+{
+    double nsPerOp = ops ? static_cast<double>(ns) / ops : 0.0;
+    double opsPerSec = ns ? ops * 1e9 / ns : 0.0;
+    printf("{\"bench\":\"%s\",\"param\":\"%s\",\"ops\":%llu,\"total_ns\":%llu,\"ns_per_op\":%.2f,\"ops_per_s\":%.1f%s%s}\n",
+        name, param.c_str(), (unsigned long long)ops, (unsigned long long)ns, nsPerOp, opsPerSec,
+        extra.empty() ? "" : ",", extra.c_str());
+    fflush(stdout);
+}
+
+string percentiles(std::vector<uint64_t>& samples)
+{
+    if(samples.empty()) return "";
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()))]; };
+    char buf[160];
+    snprintf(buf, sizeof(buf), "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu",
+        (unsigned long long)at(0.5), (unsigned long long)at(0.99), (unsigned long long)at(0.999),
+        (unsigned long long)samples.back());
+    return buf;
+}
+
+/* ---------------- Buffer ---------------- */
+
+void benchBufferInsert()
+{
+    if(!enabled("buffer_insert")) return;
+
+    for(size_t chunk : {16, 256, 4096})
+    {
+        string data(chunk, 'x');
+        uint64_t ops = 2000000 / g_scale;
+        Buffer buff;
+        uint64_t start = nowNs();
+        for(uint64_t i = 0; i < ops; ++i)
+        {
+            buff.insert(data);
+            // 累积到 64KB 就整体消费，模拟写缓冲被发送
+            if(buff.readableBytes() >= 65536) buff.clear();
+        }
+        report("buffer_insert", "chunk=" + std::to_string(chunk), ops, nowNs() - start);
+    }
+}
+
+void benchBufferReadFd()
+{
+    if(!enabled("buffer_readfd")) return;
+
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) return;
+
+    int sndBuf = 1 << 20;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndBuf, sizeof(sndBuf));
+
+    for(size_t chunk : {512, 8192, 65536 + 4096})
+    {
+        string data(chunk, 'r');
+        uint64_t ops = 200000 / g_scale;
+        uint64_t total = 0;
+        Buffer buff;
+        int err = 0;
+        for(uint64_t i = 0; i < ops; ++i)
+        {
+            // 写入不计时，只测 readFromFd（含超出可写空间时的 extrabuf 路径）
+            size_t off = 0;
+            while(off < chunk)
+            {
+                ssize_t n = write(sv[0], data.data() + off, chunk - off);
+                if(n <= 0) break;
+                off += n;
+            }
+
+            uint64_t t0 = nowNs();
+            size_t got = 0;
+            while(got < chunk)
+            {
+                ssize_t n = buff.readFromFd(sv[1], &err);
+                if(n <= 0) break;
+                got += n;
+            }
+            total += nowNs() - t0;
+            buff.clear();
+        }
+        report("buffer_readfd", "chunk=" + std::to_string(chunk), ops, total);
+    }
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+void benchBufferMakeSpace()
+{
+    if(!enabled("buffer_makespace")) return;
+
+    // 增长：从默认 1KB 一直写到 N 字节，触发多次 vector 扩容
+    for(size_t target : {64 * 1024, 1024 * 1024, 16 * 1024 * 1024})
+    {
+        uint64_t rounds = std::max<uint64_t>(1, (256ull * 1024 * 1024 / target) / g_scale);
+        string chunk(1000, 'g');
+        uint64_t start = nowNs();
+        for(uint64_t r = 0; r < rounds; ++r)
+        {
+            Buffer buff;
+            while(buff.readableBytes() < target) buff.insert(chunk);
+            keep(buff);
+        }
+        report("buffer_makespace", "grow_to=" + std::to_string(target), rounds, nowNs() - start);
+    }
+
+    // 搬移：读走大半后再写入，前部空闲足够时把可读数据移到头部而不扩容
+    for(size_t keepBytes : {64, 4096})
+    {
+        uint64_t ops = 1000000 / g_scale;
+        string chunk(2048, 'm');
+        Buffer buff(8192);
+        uint64_t start = nowNs();
+        for(uint64_t i = 0; i < ops; ++i)
+        {
+            buff.insert(chunk);
+            if(buff.readableBytes() > keepBytes)
+            {
+                buff.advance(buff.readableBytes() - keepBytes);
+            }
+        }
+        report("buffer_makespace", "compact_keep=" + std::to_string(keepBytes), ops, nowNs() - start);
+    }
+}
+
+/* ---------------- HttpRequest ---------------- */
+
+const char* CHROME_GET =
+    "GET /images/profile-image.jpg HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9090\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Referer: http://127.0.0.1:9090/picture.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+    "\r\n";
+
+const char* FIREFOX_GET =
+    "GET / HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9090\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "\r\n";
+
+// 表单 POST 到非登录页面：只走 urlencoded 解析，不访问认证后端
+const char* FORM_POST =
+    "POST /picture HTTP/1.1\r\n"
+    "Host: 127.0.0.1:9090\r\n"
+    "Content-Type: application/x-www-form-urlencoded\r\n"
+    "Content-Length: 52\r\n"
+    "Origin: http://127.0.0.1:9090\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n"
+    "username=%E5%BC%A0%E4%B8%89&password=abc%21123&x=1+2";
+
+void benchHttpParse()
+{
+    if(!enabled("http_parse")) return;
+
+    struct Case { const char* name; const char* raw; } cases[] = {
+        {"chrome_get", CHROME_GET},
+        {"firefox_get", FIREFOX_GET},
+        {"form_post", FORM_POST},
+    };
+
+    for(const Case& c : cases)
+    {
+        size_t len = strlen(c.raw);
+        uint64_t ops = 200000 / g_scale;
+        Buffer buff(4096);
+        HttpRequest req;
+        uint64_t failed = 0;
+
+        uint64_t start = nowNs();
+        for(uint64_t i = 0; i < ops; ++i)
+        {
+            buff.clear();
+            buff.insert(c.raw, len);
+            req.init();
+            if(!req.parse(buff)) ++failed;
+            keep(req);
+        }
+        uint64_t ns = nowNs() - start;
+        report("http_parse", c.name, ops, ns,
+            "\"bytes\":" + std::to_string(len) + ",\"failed\":" + std::to_string(failed));
+    }
+}
+
+/* ---------------- MinHeapTimer ---------------- */
+
+void benchTimer()
+{
+    if(!groupEnabled("timer")) return;
+
+    std::mt19937 rng(42);
+    for(int n : {10000, 100000, 1000000})
+    {
+        n = std::max(1000, n / g_scale);
+        string param = "n=" + std::to_string(n);
+        std::vector<int> timeouts(n);
+        for(int& t : timeouts) t = 60000 + static_cast<int>(rng() % 60000);
+
+        MinHeapTimer timer;
+        int fired = 0;
+
+        // add：n 个连接建立
+        uint64_t start = nowNs();
+        for(int i = 0; i < n; ++i)
+        {
+            timer.add(i, timeouts[i], [&fired]{ ++fired; });
+        }
+        if(enabled("timer_add")) report("timer_add", param, n, nowNs() - start);
+
+        // adjust：每个连接收到一次请求后续期（惰性删除会让堆里积累旧节点）
+        start = nowNs();
+        for(int i = 0; i < n; ++i)
+        {
+            timer.adjust(static_cast<int>(rng() % n), timeouts[i]);
+        }
+        if(enabled("timer_adjust")) report("timer_adjust", param, n, nowNs() - start);
+
+        // tick：无到期节点时的空转开销（反应堆每轮都会调用）
+        uint64_t idleOps = 100000 / g_scale;
+        start = nowNs();
+        for(uint64_t i = 0; i < idleOps; ++i)
+        {
+            timer.getNextTick();
+        }
+        if(enabled("timer_tick_idle")) report("timer_tick_idle", param, idleOps, nowNs() - start);
+
+        // tick：全部到期，测量逐个弹出并执行回调的开销（含旧版本节点）
+        timer.clear();
+        for(int i = 0; i < n; ++i)
+        {
+            timer.add(i, 0, [&fired]{ ++fired; });
+        }
+        for(int i = 0; i < n; i += 2)
+        {
+            timer.adjust(i, 0);
+        }
+        fired = 0;
+        start = nowNs();
+        timer.tick();
+        if(enabled("timer_tick_expire")) report("timer_tick_expire", param, n, nowNs() - start,
+            "\"fired\":" + std::to_string(fired));
+    }
+}
+
+/* ---------------- ThreadsPool ---------------- */
+
+void benchThreadsPool()
+{
+    if(!groupEnabled("threadspool")) return;
+
+    ThreadsPool pool;
+    // 等待最小线程数就绪
+    for(int i = 0; i < 100 && pool.getAliveCount() == 0; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // 延迟：逐个提交，等执行后再提交下一个，测量提交到开始执行的时间
+    if(enabled("threadspool_latency"))
+    {
+        uint64_t ops = 20000 / g_scale;
+        std::vector<uint64_t> samples;
+        samples.reserve(ops);
+        std::atomic<uint64_t> execAt{0};
+        uint64_t start = nowNs();
+        for(uint64_t i = 0; i < ops; ++i)
+        {
+            execAt.store(0, std::memory_order_relaxed);
+            uint64_t submit = nowNs();
+            pool.addTask([&execAt]{ execAt.store(nowNs(), std::memory_order_release); });
+            uint64_t t;
+            while((t = execAt.load(std::memory_order_acquire)) == 0)
+            {
+                std::this_thread::yield();
+            }
+            samples.push_back(t - submit);
+        }
+        uint64_t ns = nowNs() - start;
+        report("threadspool_latency", "serial", ops, ns, percentiles(samples));
+    }
+
+    // 吞吐：多个生产者同时提交空任务，直到全部执行完
+    if(enabled("threadspool_throughput"))
+    {
+        for(int producers : {1, 4})
+        {
+            uint64_t perProducer = 200000 / g_scale;
+            uint64_t total = perProducer * producers;
+            std::atomic<uint64_t> done{0};
+
+            uint64_t start = nowNs();
+            std::vector<std::thread> threads;
+            for(int p = 0; p < producers; ++p)
+            {
+                threads.emplace_back([&]{
+                    for(uint64_t i = 0; i < perProducer; ++i)
+                    {
+                        pool.addTask([&done]{ done.fetch_add(1, std::memory_order_relaxed); });
+                    }
+                });
+            }
+            for(auto& t : threads) t.join();
+            while(done.load(std::memory_order_relaxed) < total)
+            {
+                std::this_thread::yield();
+            }
+            report("threadspool_throughput", "producers=" + std::to_string(producers), total, nowNs() - start,
+                "\"workers\":" + std::to_string(pool.getAliveCount()));
+        }
+    }
+}
+
+/* ---------------- Log ---------------- */
+
+void benchLog()
+{
+    if(!enabled("log_access")) return;
+
+    Log* log = Log::getInstance();
+    if(!log->accessEnabled()) return;
+
+    // 分批写入并留出落盘时间，测量未丢弃时的热路径开销
+    uint64_t batch = 2000;
+    uint64_t rounds = 100 / g_scale;
+    uint64_t total = 0;
+    uint64_t droppedBefore = log->getDropped();
+    for(uint64_t r = 0; r < rounds; ++r)
+    {
+        uint64_t start = nowNs();
+        for(uint64_t i = 0; i < batch; ++i)
+        {
+            log->access("%s \"%s %s HTTP/%s\" %d %d %lluus %s", "127.0.0.1", "GET", "/images/profile-image.jpg",
+                "1.1", 200, 94712, static_cast<unsigned long long>(i), "keep-alive");
+        }
+        total += nowNs() - start;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    report("log_access", "text", batch * rounds, total,
+        "\"dropped\":" + std::to_string(log->getDropped() - droppedBefore));
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int opt;
+    while((opt = getopt(argc, argv, "f:q")) != -1)
+    {
+        switch(opt)
+        {
+            case 'f': g_filter = optarg; break;
+            case 'q': g_scale = 10; break;
+            default:
+                fprintf(stderr, "usage: %s [-f filter] [-q]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    benchBufferInsert();
+    benchBufferReadFd();
+    benchBufferMakeSpace();
+    benchHttpParse();
+    benchTimer();
+    benchThreadsPool();
+    benchLog();
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#!/usr/bin/env bash
+# CPU 绑定与 NUMA 放置对比：同一场景分别在三种配置下压测，每行一个 JSON。
+#   float   不绑定（affinity.conf enable=0），线程由调度器随意迁移
+#   node0   反应堆、工作线程、数据库线程都绑在节点 0 上，不跨节点
+#   spread  工作线程分布在所有节点，连接按收包 CPU 归属节点，同节点工作线程优先处理
+# 跨节点流量取三处：服务进程的 perf node-load-misses（有 perf 时）、
+# /sys/devices/system/node/*/numastat 的 other_node/numa_miss 增量（全机），
+# 以及 /metrics 中的 webserver_remote_node_tasks_total、webserver_buffer_rehome_total。
+# 单节点机器上三种配置的跨节点数据都为 0，只能看出绑定本身的开销。
+#
+# 用法: bench/numa.sh [webserver] [loadgen]
+# 环境变量: PORT CONNS DURATION OUT MIX
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+PORT=${PORT:-9090}
+CONNS=${CONNS:-64}
+DURATION=${DURATION:-10}
+OUT=${OUT:-bench_numa.jsonl}
+MIX=${MIX:-get:90,login:10}
+
+CONF=config/affinity.conf
+BACKUP=$(mktemp)
+cp "$CONF" "$BACKUP"
+
+SERVER_PID=
+cleanup()
+{
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    cp "$BACKUP" "$CONF"
+    rm -f "$BACKUP"
+}
+trap cleanup EXIT
+
+ALL_CPUS=$(cat /sys/devices/system/cpu/online)
+NODE0_CPUS=$(cat /sys/devices/system/node/node0/cpulist 2>/dev/null || echo "$ALL_CPUS")
+FIRST_CPU=${NODE0_CPUS%%[-,]*}
+
+# 全机各节点 numastat 指定字段之和
+numastat_sum()
+{
+    cat /sys/devices/system/node/node*/numastat 2>/dev/null | awk -v k="$1" '$1 == k { s += $2 } END { print s + 0 }'
+}
+
+metric()
+{
+    curl -s "http://127.0.0.1:$PORT/metrics" | awk -v k="$1" '$1 == k { v = $2 } END { print v + 0 }'
+}
+
+# 名称|enable|reactorCpus|workerCpus|dbCpus
+CONFIGS=(
+    "float|0|||"
+    "node0|1|$FIRST_CPU|$NODE0_CPUS|$NODE0_CPUS"
+    "spread|1|$FIRST_CPU|$ALL_CPUS|$NODE0_CPUS"
+)
+
+: > "$OUT"
+for c in "${CONFIGS[@]}"; do
+    IFS='|' read -r name enable reactor worker db <<< "$c"
+    printf 'enable=%s\nreactorCpus=%s\nworkerCpus=%s\ndbCpus=%s\nincomingCpu=1\n' \
+        "$enable" "$reactor" "$worker" "$db" > "$CONF"
+
+    "$SERVER" -p "$PORT" -m 3 >/dev/null 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 1 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+        sleep 0.1
+    done
+
+    miss0=$(numastat_sum numa_miss)
+    other0=$(numastat_sum other_node)
+    remote0=$(metric webserver_remote_node_tasks_total)
+    rehome0=$(metric webserver_buffer_rehome_total)
+
+    PERF_OUT=$(mktemp)
+    PERF_PID=
+    if command -v perf >/dev/null 2>&1; then
+        perf stat -x, -e node-loads,node-load-misses -p "$SERVER_PID" -o "$PERF_OUT" -- sleep "$DURATION" 2>/dev/null &
+        PERF_PID=$!
+    fi
+
+    result=$("$LOADGEN" -p "$PORT" -c "$CONNS" -d "$DURATION" -k 1 -m "$MIX")
+    [ -n "$PERF_PID" ] && wait "$PERF_PID"
+
+    node_loads=$(awk -F, '$3 == "node-loads" { print $1 }' "$PERF_OUT")
+    node_misses=$(awk -F, '$3 == "node-load-misses" { print $1 }' "$PERF_OUT")
+    rm -f "$PERF_OUT"
+
+    line=$(printf '{"config":"%s","reactor_cpus":"%s","worker_cpus":"%s","numa_miss":%d,"other_node":%d,"remote_tasks":%d,"buffer_rehome":%d,"node_loads":"%s","node_load_misses":"%s","result":%s}' \
+        "$name" "$reactor" "$worker" \
+        $(( $(numastat_sum numa_miss) - miss0 )) $(( $(numastat_sum other_node) - other0 )) \
+        $(( $(metric webserver_remote_node_tasks_total) - remote0 )) $(( $(metric webserver_buffer_rehome_total) - rehome0 )) \
+        "${node_loads:-n/a}" "${node_misses:-n/a}" "$result")
+    echo "$line" | tee -a "$OUT"
+
+    kill "$SERVER_PID" 2>/dev/null
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=
+done
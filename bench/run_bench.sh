@@ -0,0 +1,72 @@
+#!/usr/bin/env bash
+# 场景矩阵压测：对每种触发模式(trigMode 0~3)启动一次 webserver，
+# 依次跑 短连接/长连接/流水线 × 静态资源/登录注册混合 场景，再跑一次连接风暴，结果为每行一个 JSON。
+#
+# 用法: bench/run_bench.sh [webserver] [loadgen] [connstorm]
+# 环境变量: PORT CONNS DURATION TRIG_MODES OUT
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+CONNSTORM=${3:-build/connstorm}
+PORT=${PORT:-9090}
+CONNS=${CONNS:-64}
+DURATION=${DURATION:-10}
+TRIG_MODES=${TRIG_MODES:-"0 1 2 3"}
+OUT=${OUT:-bench_results.jsonl}
+
+# 名称|keepalive|pipeline|mix
+SCENARIOS=(
+    "static_close|0|1|get:100"
+    "static_keepalive|1|1|get:100"
+    "static_pipeline8|1|8|get:100"
+    "auth_mix_keepalive|1|1|get:80,login:15,register:5"
+)
+
+: > "$OUT"
+SERVER_PID=
+
+stop_server()
+{
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=
+    fi
+}
+trap stop_server EXIT
+
+wait_port()
+{
+    for _ in $(seq 1 50); do
+        if (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    return 1
+}
+
+for mode in $TRIG_MODES; do
+    "$SERVER" -p "$PORT" -m "$mode" >/dev/null 2>&1 &
+    SERVER_PID=$!
+    if ! wait_port; then
+        echo "webserver failed to start (trigMode=$mode)" >&2
+        stop_server
+        exit 1
+    fi
+
+    for s in "${SCENARIOS[@]}"; do
+        IFS='|' read -r name ka depth mix <<< "$s"
+        result=$("$LOADGEN" -p "$PORT" -c "$CONNS" -d "$DURATION" -k "$ka" -P "$depth" -m "$mix")
+        line="{\"trig_mode\":$mode,\"scenario\":\"$name\",${result#\{}"
+        echo "$line" | tee -a "$OUT"
+    done
+
+    if [ -x "$CONNSTORM" ]; then
+        result=$("$CONNSTORM" -p "$PORT" -c "$((CONNS * 8))" -d "$DURATION")
+        echo "{\"trig_mode\":$mode,\"scenario\":\"connect_storm\",${result#\{}" | tee -a "$OUT"
+    fi
+
+    stop_server
+done
@@ -0,0 +1,89 @@
+#!/usr/bin/env bash
+# 响应发送策略对比：每种策略下按响应大小压测，统计每个响应对应的 TCP 报文段数，每行一个 JSON。
+#   off    不 cork、不设置 TCP_NODELAY（原来的行为）
+#   cork   只对大文件响应 TCP_CORK
+#   full   TCP_CORK + 长连接小响应 TCP_NODELAY（默认配置）
+# 报文段数取 /proc/net/snmp 中 Tcp OutSegs 的增量（全机），除以完成的请求数。
+# 经回环压测时客户端的请求和 ACK 也计入，各策略下这部分相同，差值即服务端发送的变化；
+# 用 HOST 指定本机网卡地址或在另一台机器上运行 loadgen 时结果更接近真实网络。
+#
+# 用法: bench/segments.sh [webserver] [loadgen]
+# 环境变量: HOST PORT CONNS DURATION OUT
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+HOST=${HOST:-127.0.0.1}
+PORT=${PORT:-9090}
+CONNS=${CONNS:-16}
+DURATION=${DURATION:-10}
+OUT=${OUT:-bench_segments.jsonl}
+
+CONF=config/server.conf
+BACKUP=$(mktemp)
+cp "$CONF" "$BACKUP"
+
+SERVER_PID=
+cleanup()
+{
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    cp "$BACKUP" "$CONF"
+    rm -f "$BACKUP"
+}
+trap cleanup EXIT
+
+out_segs()
+{
+    awk '$1 == "Tcp:" && $2 ~ /^[0-9]+$/ { print $12 }' /proc/net/snmp
+}
+
+set_conf()
+{
+    sed -i "s/^$1=.*/$1=$2/" "$CONF"
+}
+
+# 名称|tcpCork|smallResponse
+POLICIES=(
+    "off|0|0"
+    "cork|1|0"
+    "full|1|16384"
+)
+
+# 名称|路径（约 3KB、10KB、100KB、360KB）
+SIZES=(
+    "3k|/index.html"
+    "10k|/css/style.css"
+    "100k|/images/instagram-image4.jpg"
+    "360k|/fonts/fontawesome-webfont.svg"
+)
+
+: > "$OUT"
+for p in "${POLICIES[@]}"; do
+    IFS='|' read -r policy cork small <<< "$p"
+    set_conf tcpCork "$cork"
+    set_conf smallResponse "$small"
+
+    "$SERVER" -p "$PORT" -m 3 >/dev/null 2>&1 &
+    SERVER_PID=$!
+    for _ in $(seq 1 50); do
+        (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+        sleep 0.1
+    done
+
+    for s in "${SIZES[@]}"; do
+        IFS='|' read -r size path <<< "$s"
+        start=$(out_segs)
+        result=$("$LOADGEN" -h "$HOST" -p "$PORT" -c "$CONNS" -d "$DURATION" -k 1 -u "$path")
+        segs=$(( $(out_segs) - start ))
+        requests=$(echo "$result" | grep -o '"requests":[0-9]*' | cut -d: -f2)
+
+        line=$(awk -v p="$policy" -v s="$size" -v g="$segs" -v n="${requests:-0}" -v r="$result" \
+            'BEGIN { printf "{\"policy\":\"%s\",\"size\":\"%s\",\"out_segs\":%d,\"segs_per_response\":%.2f,\"result\":%s}",
+                     p, s, g, (n > 0 ? g / n : 0), r }')
+        echo "$line" | tee -a "$OUT"
+    done
+
+    kill "$SERVER_PID" 2>/dev/null
+    wait "$SERVER_PID" 2>/dev/null
+    SERVER_PID=
+done
@@ -0,0 +1,54 @@
+#!/usr/bin/env bash
+# 回环 TCP 与 Unix 域套接字对比：同一个 webserver 同时监听两者，
+# 对每种场景分别经 TCP 和 UDS 压测，结果为每行一个 JSON（loadgen 输出带 transport 字段）。
+#
+# 用法: bench/uds.sh [webserver] [loadgen]
+# 环境变量: PORT SOCK CONNS DURATION OUT
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+PORT=${PORT:-9090}
+SOCK=${SOCK:-/tmp/webserver_bench.sock}
+CONNS=${CONNS:-64}
+DURATION=${DURATION:-10}
+OUT=${OUT:-bench_uds.jsonl}
+
+# 名称|keepalive|pipeline|mix|paths
+SCENARIOS=(
+    "small_keepalive|1|1|get:100|/index.html"
+    "small_close|0|1|get:100|/index.html"
+    "small_pipeline8|1|8|get:100|/index.html"
+    "mixed_keepalive|1|1|get:100|"
+)
+
+: > "$OUT"
+"$SERVER" -p "$PORT" -m 3 -u "$SOCK" >/dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null' EXIT
+
+for _ in $(seq 1 50); do
+    [ -S "$SOCK" ] && (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    sleep 0.1
+done
+if [ ! -S "$SOCK" ]; then
+    echo "webserver did not create $SOCK" >&2
+    exit 1
+fi
+
+for s in "${SCENARIOS[@]}"; do
+    IFS='|' read -r name ka depth mix paths <<< "$s"
+    args=(-c "$CONNS" -d "$DURATION" -k "$ka" -P "$depth" -m "$mix")
+    [ -n "$paths" ] && args+=(-u "$paths")
+
+    # 两种传输交替进行，减少机器状态漂移的影响
+    for transport in tcp unix; do
+        if [ "$transport" = tcp ]; then
+            result=$("$LOADGEN" -p "$PORT" "${args[@]}")
+        else
+            result=$("$LOADGEN" -U "$SOCK" "${args[@]}")
+        fi
+        line="{\"scenario\":\"$name\",\"result\":$result}"
+        echo "$line" | tee -a "$OUT"
+    done
+done
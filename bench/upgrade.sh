@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+# 不停机升级验证：持续压测（长连接和短连接各一路）期间多次 kill -USR2，
+# 新进程接管监听套接字、旧进程排空后退出，任一路出现失败请求即返回非 0。
+#
+# 用法: bench/upgrade.sh [webserver] [loadgen]
+# 环境变量: PORT CONNS DURATION UPGRADES
+set -u
+
+SERVER=${1:-build/webserver}
+LOADGEN=${2:-build/loadgen}
+PORT=${PORT:-9090}
+CONNS=${CONNS:-32}
+DURATION=${DURATION:-12}
+UPGRADES=${UPGRADES:-3}
+
+SERVER_PID=
+cleanup()
+{
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null
+    rm -f /tmp/upgrade_ka.$$ /tmp/upgrade_close.$$
+}
+trap cleanup EXIT
+
+"$SERVER" -p "$PORT" -m 3 >/dev/null 2>&1 &
+SERVER_PID=$!
+for _ in $(seq 1 50); do
+    (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    sleep 0.1
+done
+
+"$LOADGEN" -p "$PORT" -c "$CONNS" -d "$DURATION" -k 1 -m get:80,login:10,register:10 > /tmp/upgrade_ka.$$ 2>/dev/null &
+KA_PID=$!
+"$LOADGEN" -p "$PORT" -c "$CONNS" -d "$DURATION" -k 0 > /tmp/upgrade_close.$$ 2>/dev/null &
+CLOSE_PID=$!
+
+# 升级均匀分布在压测中段
+INTERVAL=$(( DURATION / (UPGRADES + 1) ))
+for i in $(seq 1 "$UPGRADES"); do
+    sleep "$INTERVAL"
+    OLD=$SERVER_PID
+    kill -USR2 "$OLD"
+    NEW=
+    for _ in $(seq 1 50); do
+        NEW=$(pgrep -P "$OLD" -x "$(basename "$SERVER")" | head -1)
+        [ -n "$NEW" ] && break
+        sleep 0.1
+    done
+    if [ -z "$NEW" ]; then
+        echo "upgrade $i: new process did not start" >&2
+        exit 1
+    fi
+    SERVER_PID=$NEW
+    echo "upgrade $i: $OLD -> $NEW" >&2
+done
+
+wait "$KA_PID" "$CLOSE_PID"
+
+FAILED=0
+for f in /tmp/upgrade_ka.$$ /tmp/upgrade_close.$$; do
+    line=$(tail -n 1 "$f")
+    echo "{\"scenario\":\"upgrade_x$UPGRADES\",\"result\":$line}"
+    case "$line" in
+        *'"errors":0,'*) ;;
+        *) FAILED=1 ;;
+    esac
+done
+exit $FAILED
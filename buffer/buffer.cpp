@@ -62,6 +62,14 @@ void Buffer::clear()
     m_writeIdx = 0;
 }
 
+void Buffer::reallocate()
+{
+    assert(readableBytes() == 0);
+    std::vector<char>(m_buffer.size()).swap(m_buffer);
+    m_readIdx = 0;
+    m_writeIdx = 0;
+}
+
 string Buffer::clearAndToStr()
 {
     string str(readBegin(), readableBytes());
@@ -32,6 +32,7 @@ public:
     void advance(size_t len);               // 读索引前进len
     void advance(const char* end);          // 读索引前进到某个位置
     void clear();                           // 清空缓冲区
+    void reallocate();                      // 在调用线程上重新分配同样大小的底层存储（首次写入决定所在 NUMA 节点），仅在缓冲区为空时使用
     string clearAndToStr();                 // 清空缓冲区并返回内容
 
     const char* writeBeginConst() const;    // 开始写的位置,常量
@@ -3,11 +3,20 @@
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+size_t HttpConn::maxHeaderSize = 8192;
+size_t HttpConn::maxBodySize = 1 << 20;
+std::atomic<bool> HttpConn::draining(false);
+std::atomic<int> HttpConn::keepAliveMax(100);
+std::atomic<int> HttpConn::keepAliveTimeout(60000);
+bool HttpConn::corkResponses = true;
+int HttpConn::smallResponse = 16384;
 
 HttpConn::HttpConn()
-:m_fd(-1), m_iovCnt(2), m_isClose(false)
+:m_fd(-1), m_iovCnt(2), m_isClose(false), m_ipCounted(false), m_traceId(0), m_traceQueuedUs(0), m_parseCostUs(0), m_requests(0), m_keepAliveMs(0), m_inWorker(false), m_expirePending(false),
+m_corked(false), m_nodelay(false), m_node(-1), m_memNode(CpuAffinity::currentNode()), m_stage(STAGE_IDLE), m_stageStartUs(0), m_stageBytes(0)
 {
-    m_addr = { 0 };
+    m_addr = {};
+    m_ip[0] = '\0';
 }
 
 HttpConn::~HttpConn()
@@ -15,16 +24,42 @@ HttpConn::~HttpConn()
     closeConn();
 }
 
-void HttpConn::init(int fd, const sockaddr_in& addr)
+void HttpConn::init(int fd, const sockaddr_storage& addr)
 {
     assert(fd > 0);
     ++userCount;
     m_fd = fd;
     m_addr = addr;
+    if(m_addr.ss_family == AF_INET)
+    {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(&m_addr)->sin_addr, m_ip, sizeof(m_ip));
+    }
+    else if(m_addr.ss_family == AF_INET6)
+    {
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(&m_addr)->sin6_addr, m_ip, sizeof(m_ip));
+    }
+    else
+    {
+        // Unix 域套接字的对端（本机反向代理）通常没有绑定路径
+        snprintf(m_ip, sizeof(m_ip), "unix");
+    }
 
     m_readBuff.clear();
     m_writeBuff.clear();
     m_isClose = false;
+    m_ipCounted = false;
+    m_traceId = 0;
+    m_traceQueuedUs = 0;
+    m_requests = 0;
+    m_keepAliveMs.store(keepAliveTimeout.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_inWorker = false;
+    m_expirePending = false;
+    m_corked = false;
+    m_nodelay = false;
+    m_node = -1;
+    m_stage.store(STAGE_IDLE, std::memory_order_relaxed);
+    m_stageStartUs.store(Metrics::nowUs(), std::memory_order_relaxed);
+    m_stageBytes.store(0, std::memory_order_relaxed);
 
 #ifdef DEBUG
         std::cout << "Http init for client [" << fd << "]." << std::endl;
@@ -32,6 +67,25 @@ void HttpConn::init(int fd, const sockaddr_in& addr)
 
 }
 
+void HttpConn::bindMemory()
+{
+    // 被其他节点的工作线程取走时不迁移，避免缓冲区在节点间来回搬
+    int node = CpuAffinity::currentNode();
+    if(node < 0 || node != m_node || node == m_memNode)
+    {
+        return;
+    }
+    if(m_readBuff.readableBytes() > 0 || m_writeBuff.readableBytes() > 0)
+    {
+        return;
+    }
+
+    m_readBuff.reallocate();
+    m_writeBuff.reallocate();
+    m_memNode = node;
+    Metrics::inc(Metrics::BUFFER_REHOMED);
+}
+
 void HttpConn::closeConn()
 {
     m_response.unmap();
@@ -48,19 +102,27 @@ int HttpConn::getFd() const
     return m_fd;
 }
 
-sockaddr_in HttpConn::getAddr() const
+const sockaddr_storage& HttpConn::getAddr() const
 {
     return m_addr;
 }
 
 int HttpConn::getPost() const
 {
-    return m_addr.sin_port;
+    if(m_addr.ss_family == AF_INET)
+    {
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&m_addr)->sin_port);
+    }
+    if(m_addr.ss_family == AF_INET6)
+    {
+        return ntohs(reinterpret_cast<const sockaddr_in6*>(&m_addr)->sin6_port);
+    }
+    return 0;
 }
 
 const char* HttpConn::getIp() const
 {
-    return inet_ntoa(m_addr.sin_addr);
+    return m_ip;
 }
 
 ssize_t HttpConn::readFromClnt(int* saveErrno)
@@ -69,10 +131,13 @@ ssize_t HttpConn::readFromClnt(int* saveErrno)
     do
     {
         len = m_readBuff.readFromFd(m_fd, saveErrno);
-        if(len < 0)
+        // 出错或对端关闭（len == 0）都要退出，否则 ET 模式下会空转
+        if(len <= 0)
         {
             break;
         }
+        Metrics::inc(Metrics::BYTES_IN, len);
+        m_stageBytes.fetch_add(len, std::memory_order_relaxed);
         
     } while (isET);
 
@@ -90,6 +155,8 @@ ssize_t HttpConn::writeToClnt(int* saveError)
             *saveError = errno;
             break;
         }
+        Metrics::inc(Metrics::BYTES_OUT, len);
+        m_stageBytes.fetch_add(len, std::memory_order_relaxed);
 
         // 传输结束
         if(m_iov[0].iov_len + m_iov[1].iov_len == 0) break;
@@ -115,23 +182,144 @@ ssize_t HttpConn::writeToClnt(int* saveError)
         
     } while (isET || toWriteBytes() > 10240);      // ET模式或大数据量时循环写
 
+    // 响应写完才解除，最后一个不满的报文段随之发出
+    if(m_corked && toWriteBytes() == 0)
+    {
+        setTcpOption(TCP_CORK, false);
+        m_corked = false;
+    }
+
     return len;
     
 }
 
+void HttpConn::enterStage(STAGE stage, bool restart)
+{
+    if(!restart && m_stage.load(std::memory_order_relaxed) == stage) return;
+
+    m_stage.store(stage, std::memory_order_relaxed);
+    m_stageStartUs.store(Metrics::nowUs(), std::memory_order_relaxed);
+    m_stageBytes.store(0, std::memory_order_relaxed);
+}
+
+/* 请求未完整到达时记录阶段并返回 true，等待更多数据；否则由 frame 带回到达情况 */
+bool HttpConn::needMore(HttpRequest::FRAME& frame)
+{
+    if(m_readBuff.readableBytes() <= 0)
+    {
+        enterStage(STAGE_IDLE);
+        return true;
+    }
+
+    frame = HttpRequest::frame(m_readBuff, maxHeaderSize, maxBodySize);
+    if(frame == HttpRequest::FRAME_HEADER)
+    {
+        enterStage(STAGE_HEADER);
+        return true;
+    }
+    if(frame == HttpRequest::FRAME_BODY)
+    {
+        enterStage(STAGE_BODY);
+        return true;
+    }
+    return false;
+}
+
+bool HttpConn::isCheap() const
+{
+    HttpRequest::FRAME frame = HttpRequest::frame(m_readBuff, maxHeaderSize, maxBodySize);
+    if(frame != HttpRequest::FRAME_COMPLETE)
+    {
+        return true;
+    }
+
+    // 登录/注册只走 POST，其余方法都不访问数据库
+    return m_readBuff.readableBytes() < 5 || memcmp(m_readBuff.readBegin(), "POST ", 5) != 0;
+}
+
 bool HttpConn::process()
 {
     m_request.init();
-    if(m_readBuff.readableBytes() <= 0)
+    HttpRequest::FRAME frame = HttpRequest::FRAME_COMPLETE;
+    if(needMore(frame))
     {
         return false;
     }
+    enterStage(STAGE_PROCESS);
     
-    if(m_request.parse(m_readBuff))
+    uint64_t start = Metrics::nowUs();
+    if(frame != HttpRequest::FRAME_COMPLETE)
+    {
+        makeRejectResponse(frame);
+        logAccess(Metrics::nowUs() - start);
+        return true;
+    }
+
+    m_request.setTraceId(m_traceId);
+    bool parsed;
+    {
+        TraceScope trace(m_traceId, Trace::PARSE);
+        parsed = m_request.parse(m_readBuff);
+    }
+    uint64_t cost = Metrics::nowUs() - start;
+
+    // 校验推迟到协程：只有这类请求才付出协程帧的开销
+    if(parsed && m_request.needVerify())
+    {
+        m_parseCostUs = cost;
+        return true;
+    }
+
+    finishProcess(parsed, cost);
+    return true;
+}
+
+Task<void> HttpConn::verifyAsync()
+{
+    // 数据库往返期间协程挂起，线程可以去处理别的连接
+    co_await m_request.verifyAsync();
+    finishProcess(true, m_parseCostUs);
+}
+
+void HttpConn::finishProcess(bool parsed, uint64_t costUs)
+{
+    // 不计入挂起等待数据库的时间
+    uint64_t start = Metrics::nowUs();
+    {
+        TraceScope trace(m_traceId, Trace::RESPONSE);
+        makeResponse(parsed);
+    }
+    costUs += Metrics::nowUs() - start;
+    Metrics::observe(Metrics::PARSE_TIME, costUs);
+    logAccess(costUs);
+}
+
+void HttpConn::logAccess(uint64_t costUs)
+{
+    Log* log = Log::getInstance();
+    if(!log->accessEnabled()) return;
+
+    // ip "方法 路径 版本" 状态码 响应字节数 处理耗时 连接方式
+    const string& method = m_request.method();
+    log->access("%s \"%s %s HTTP/%s\" %d %d %lluus %s", getIp(),
+        method.empty() ? "-" : method.c_str(), m_request.path().c_str(), m_request.version().c_str(),
+        m_response.code(), toWriteBytes(), static_cast<unsigned long long>(costUs),
+        m_response.isKeepAlive() ? "keep-alive" : "close");
+}
+
+void HttpConn::makeResponse(bool parsed)
+{
+    if(parsed)
     {
         // 解析成功
         // 初始化响应：资源目录、请求路径、长连接标志、状态码200
-        m_response.init(srcDir, m_request.path(), m_request.isKeepAlive(), 200);
+        int remaining = m_request.isKeepAlive() ? allowKeepAlive() : 0;
+        m_response.init(srcDir, m_request.path(), remaining > 0, 200);
+        if(remaining > 0)
+        {
+            // 通告的超时向下取整，客户端不会在服务端关闭之后还复用连接
+            m_response.setKeepAlive(keepAliveMs() / 1000, remaining);
+        }
     }
     else
     {
@@ -139,12 +327,69 @@ bool HttpConn::process()
         m_response.init(srcDir, m_request.path(), false, 400);
     }
 
-    // 生成响应写到缓冲区
+    if(!m_request.newSession().empty())
+    {
+        m_response.setCookie(string(SessionStore::COOKIE_NAME) + "=" + m_request.newSession()
+            + "; Path=/; HttpOnly; Max-Age=" + std::to_string(SessionStore::getInstance()->ttl()));
+    }
+
+    // 保留路径：运行指标
+    if(parsed && m_request.path() == Metrics::PATH)
+    {
+        m_response.setContent(Metrics::render(), "text/plain; version=0.0.4");
+    }
+    else if(parsed && m_request.path() == Trace::PATH)
+    {
+        m_response.setContent(Trace::dump(), "application/json");
+    }
+
+    finishResponse();
+}
+
+int HttpConn::allowKeepAlive()
+{
+    // 策略在响应生成时取一次，通告给客户端的就是本连接之后实际执行的
+    ++m_requests;
+    int max = keepAliveMax.load(std::memory_order_relaxed);
+    if(max <= m_requests || draining.load(std::memory_order_relaxed))
+    {
+        Metrics::inc(Metrics::KEEPALIVE_REFUSED);
+        return 0;
+    }
+
+    m_keepAliveMs.store(keepAliveTimeout.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return max - m_requests;
+}
+
+void HttpConn::makeRejectResponse(HttpRequest::FRAME frame)
+{
+    // 超限的请求不解析，丢弃已读数据，响应后关闭连接
+    m_readBuff.clear();
+    if(frame == HttpRequest::FRAME_HEADER_TOO_LARGE)
+    {
+        m_response.init(srcDir, m_request.path(), false, 431);
+        m_response.setContent("Request header too large.\n", "text/plain");
+    }
+    else
+    {
+        m_response.init(srcDir, m_request.path(), false, 413);
+        m_response.setContent("Request body too large.\n", "text/plain");
+    }
+    finishResponse();
+}
+
+void HttpConn::finishResponse()
+{
+    // 生成响应写到缓冲区，之后进入发送阶段（流水线中的下一个响应重新计时）
     m_response.makeResponse(m_writeBuff);
+    enterStage(STAGE_DRAIN, true);
+    Metrics::status(m_response.code());
 
     /* 响应头 */
     m_iov[0].iov_base = const_cast<char*>(m_writeBuff.readBegin());
     m_iov[0].iov_len = m_writeBuff.readableBytes();
+    m_iov[1].iov_base = nullptr;
+    m_iov[1].iov_len = 0;
     m_iovCnt = 1;
 
     /* 文件 */
@@ -155,5 +400,40 @@ bool HttpConn::process()
         m_iovCnt = 2;
     }
 
-    return true;
+    applySendPolicy();
+}
+
+void HttpConn::applySendPolicy()
+{
+    // Unix 域套接字没有报文段
+    if(m_addr.ss_family != AF_INET && m_addr.ss_family != AF_INET6)
+    {
+        return;
+    }
+
+    if(toWriteBytes() <= smallResponse)
+    {
+        // 短连接关闭时会立即发出剩余数据，不需要 TCP_NODELAY
+        if(!m_nodelay && isKeepAlive())
+        {
+            setTcpOption(TCP_NODELAY, true);
+            m_nodelay = true;
+        }
+    }
+    else if(corkResponses && m_iovCnt == 2 && !m_corked)
+    {
+        // 响应头和文件首段合在满 MSS 的报文段里，不会单独发出只有响应头的小报文段
+        setTcpOption(TCP_CORK, true);
+        m_corked = true;
+        Metrics::inc(Metrics::CORKED_RESPONSES);
+    }
+}
+
+void HttpConn::setTcpOption(int opt, bool on)
+{
+    int val = on ? 1 : 0;
+    if(setsockopt(m_fd, IPPROTO_TCP, opt, &val, sizeof(val)) < 0)
+    {
+        LOG_DEBUG("client[%d] set tcp option %d to %d failed: %s", m_fd, opt, val, strerror(errno));
+    }
 }
\ No newline at end of file
@@ -4,54 +4,146 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <cstdio>
 #include <cerrno>
 
 #include "httpRequest.h"
 #include "httpResponse.h"
+#include "../utils/coTask.h"
+#include "../metrics/metrics.h"
+#include "../log/log.h"
+#include "../metrics/trace.h"
+#include "../utils/cpuAffinity.h"
 
 
 class HttpConn
 {
 
+public:
+    /* 连接所处阶段，反应堆据此计算截止时间（防慢速攻击） */
+    enum STAGE
+    {
+        STAGE_IDLE = 0,         // 等待下一个请求
+        STAGE_HEADER,           // 请求头接收中
+        STAGE_BODY,             // 请求体接收中
+        STAGE_PROCESS,          // 请求已收全，服务端处理中（含等待数据库）
+        STAGE_DRAIN,            // 响应发送中
+        STAGE_NUM,
+    };
+
 public:
     HttpConn();
     ~HttpConn();
 
-    void init(int sockfd, const sockaddr_in& addr);
+    void init(int sockfd, const sockaddr_storage& addr);
 
     ssize_t readFromClnt(int* saveError);
     ssize_t writeToClnt(int* saveError);
 
     void closeConn();
+    bool isClosed() const { return m_isClose; }
     int getFd() const;
+    /* 对端地址：TCP 为 IPv4 地址和端口，Unix 域套接字为 "unix" 和 0 */
     int getPost() const;
     const char* getIp() const;
-    sockaddr_in getAddr() const;
+    const sockaddr_storage& getAddr() const;
 
+    /* 登录/注册需要访问数据库时，process 解析后不生成响应，needVerify 为真，由 verifyAsync 在协程中完成 */
     bool process();
+    bool needVerify() const { return m_request.needVerify(); }
+    Task<void> verifyAsync();
 
     int toWriteBytes() const
     {
         return m_iov[0].iov_len + m_iov[1].iov_len;
     }
 
+    /* 以已生成响应中的 Connection 为准，与发给客户端的一致 */
     bool isKeepAlive() const
     {
-        return m_request.isKeepAlive();
+        return m_response.isKeepAlive();
+    }
+
+    /* 缓冲区中的下一个请求不会访问数据库（非 POST，或尚不完整、超限），可以在反应堆上直接处理 */
+    bool isCheap() const;
+
+    /* 已读入尚未解析的字节数（流水线中的后续请求） */
+    size_t pendingBytes() const
+    {
+        return m_readBuff.readableBytes();
     }
 
+    /* 请求追踪：id 为 0 表示本次请求未被采样 */
+    uint32_t traceId() const { return m_traceId; }
+    void setTraceId(uint32_t id) { m_traceId = id; }
+    uint64_t traceQueuedUs() const { return m_traceQueuedUs; }
+    void setTraceQueuedUs(uint64_t us) { m_traceQueuedUs = us; }
+
+    /* 阶段与本阶段已收发的字节数：工作线程写，反应堆和定时器读 */
+    STAGE stage() const { return static_cast<STAGE>(m_stage.load(std::memory_order_relaxed)); }
+    uint64_t stageStartUs() const { return m_stageStartUs.load(std::memory_order_relaxed); }
+    uint64_t stageBytes() const { return m_stageBytes.load(std::memory_order_relaxed); }
+    void enterStage(STAGE stage, bool restart = false);
+
+    /* 本连接空闲超时：取最近一次响应中通告的值，工作线程写，反应堆和定时器读 */
+    int keepAliveMs() const { return m_keepAliveMs.load(std::memory_order_relaxed); }
+
+    /* 连接交给工作线程期间由其独占，经完成队列交回；仅反应堆读写 */
+    bool inWorker() const { return m_inWorker; }
+    void setInWorker(bool inWorker) { m_inWorker = inWorker; }
+    bool expirePending() const { return m_expirePending; }
+    void setExpirePending(bool pending) { m_expirePending = pending; }
+
+    /* 是否计入了来源 IP 的并发连接数，关闭时只归还计入过的 */
+    bool ipCounted() const { return m_ipCounted; }
+    void setIpCounted(bool counted) { m_ipCounted = counted; }
+
+    /* 所属 NUMA 节点：收包 CPU 所在节点，-1 表示不限 */
+    int node() const { return m_node; }
+    void setNode(int node) { m_node = node; }
+    /* 工作线程调用：本线程在所属节点上时，把空闲的缓冲区重新分配到本节点 */
+    void bindMemory();
+
 public:
     static const char* srcDir;              // 静态资源目录
     static std::atomic<int> userCount;      // 记录当前活跃连接数
     static bool isET;                       // 标识连接是否使用边缘触发
+    static size_t maxHeaderSize;            // 请求头上限，超过回 431
+    static size_t maxBodySize;              // 请求体上限，超过回 413
+    static std::atomic<bool> draining;      // 升级排空中，之后的响应不再保持连接
+    /* 当前生效的长连接策略，由反应堆按连接压力调整：每连接请求数上限（0 不保持）和空闲超时（毫秒，0 不限） */
+    static std::atomic<int> keepAliveMax;
+    static std::atomic<int> keepAliveTimeout;
+    /**
+     *  响应发送策略（仅 TCP）：超过 smallResponse 字节的文件响应在写出响应头和文件首段前 TCP_CORK，
+     *  整个响应写完再解除，只发满 MSS 的报文段；长连接上的小响应设置 TCP_NODELAY（之后保持），
+     *  最后一个不满的报文段不因 Nagle 等待上一个响应的 ACK
+     */
+    static bool corkResponses;
+    static int smallResponse;               // 0 为不设置 TCP_NODELAY
 
 
+private:
+    bool needMore(HttpRequest::FRAME& frame);
+    int allowKeepAlive();
+    void makeResponse(bool parsed);
+    void finishProcess(bool parsed, uint64_t costUs);
+    void makeRejectResponse(HttpRequest::FRAME frame);
+    void finishResponse();
+    void applySendPolicy();
+    void setTcpOption(int opt, bool on);
+    void logAccess(uint64_t costUs);
+
 private:
     int m_fd;
-    struct sockaddr_in m_addr;
+    struct sockaddr_storage m_addr;
+    char m_ip[INET6_ADDRSTRLEN];    // 在 init 中格式化，工作线程写日志时直接使用
 
     bool m_isClose;
+    bool m_ipCounted;
 
     int m_iovCnt;
     struct iovec m_iov[2];
@@ -61,6 +153,26 @@ private:
 
     HttpRequest m_request;
     HttpResponse m_response;
+
+    uint32_t m_traceId;
+    uint64_t m_traceQueuedUs;   // 追踪：任务入队时间
+    uint64_t m_parseCostUs;     // 推迟校验的请求已用的解析时间
+
+    int m_requests;             // 本连接已响应的请求数
+    std::atomic<int> m_keepAliveMs;     // 本连接的空闲超时
+
+    bool m_inWorker;            // 已交给工作线程，尚未交回
+    bool m_expirePending;       // 在工作线程期间到期，交回后关闭
+
+    bool m_corked;              // 当前响应写完前处于 TCP_CORK
+    bool m_nodelay;             // 已设置 TCP_NODELAY
+
+    int m_node;                 // 所属 NUMA 节点
+    int m_memNode;              // 缓冲区当前所在节点，-1 未知
+
+    std::atomic<int> m_stage;
+    std::atomic<uint64_t> m_stageStartUs;
+    std::atomic<uint64_t> m_stageBytes;
 };
 
 #endif
\ No newline at end of file
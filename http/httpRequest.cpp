@@ -12,14 +12,66 @@ const std::unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG
     {"/login.html", 1},
 };
 
+bool HttpRequest::asyncVerify = false;
+bool HttpRequest::asyncRegister = false;
+
 void HttpRequest::init()
 {
     m_mthod = m_path = m_version = m_body = "";
     m_curState = CHECK_REQUESTLINE;
+    m_verifyTag = -1;
+    m_sessionUser.clear();
+    m_newSession.clear();
     m_header.clear();
     m_userInfo.clear();
 }
 
+HttpRequest::FRAME HttpRequest::frame(const Buffer& buff, size_t maxHeader, size_t maxBody)
+{
+    static const char END[] = "\r\n\r\n";
+    static const char CONTENT_LENGTH[] = "content-length:";
+    static const size_t CL_LEN = sizeof(CONTENT_LENGTH) - 1;
+
+    const char* begin = buff.readBegin();
+    const char* end = begin + buff.readableBytes();
+
+    const char* headEnd = std::search(begin, end, END, END + 4);
+    if(headEnd == end)
+    {
+        return buff.readableBytes() > maxHeader ? FRAME_HEADER_TOO_LARGE : FRAME_HEADER;
+    }
+
+    size_t headLen = headEnd + 4 - begin;
+    if(headLen > maxHeader)
+    {
+        return FRAME_HEADER_TOO_LARGE;
+    }
+
+    // 与 parse 一致：只有 POST 按 Content-Length 读取请求体
+    size_t bodyLen = 0;
+    if(strncmp(begin, "POST ", 5) == 0)
+    {
+        for(const char* line = begin; line < headEnd; )
+        {
+            const char* lineEnd = std::search(line, headEnd, END, END + 2);
+            if(static_cast<size_t>(lineEnd - line) > CL_LEN && strncasecmp(line, CONTENT_LENGTH, CL_LEN) == 0)
+            {
+                // 行尾之后一定还有 \r\n\r\n，strtoul 不会越界
+                bodyLen = std::strtoul(line + CL_LEN, nullptr, 10);
+                break;
+            }
+            line = lineEnd + 2;
+        }
+    }
+
+    if(bodyLen > maxBody)
+    {
+        return FRAME_BODY_TOO_LARGE;
+    }
+
+    return buff.readableBytes() - headLen < bodyLen ? FRAME_BODY : FRAME_COMPLETE;
+}
+
 bool HttpRequest::parse(Buffer& buff)
 {
     const char CRLF[] = "\r\n";
@@ -27,6 +79,16 @@ bool HttpRequest::parse(Buffer& buff)
 
     while(buff.readableBytes() && m_curState != CHECK_FINISH)
     {
+        // 带 Content-Length 的请求体按长度截取，避免吞掉流水线中的下一个请求
+        if(m_curState == CHECK_CONTENT && m_header.count("content-length"))
+        {
+            size_t len = std::min<size_t>(std::strtoul(m_header["content-length"].c_str(), nullptr, 10), buff.readableBytes());
+            string body(buff.readBegin(), buff.readBegin() + len);
+            buff.advance(len);
+            parseBody(body);
+            break;
+        }
+
         // 查找当前行的结束符
         const char* lineEnd = std::search(buff.readBegin(), buff.writeBeginConst(), CRLF, CRLF + 2);
 
@@ -112,7 +174,8 @@ void HttpRequest::parsePath()
 
 bool HttpRequest::parseRequstLine(const string& line)
 {
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+    // 正则只编译一次，每行都构造 std::regex 的开销远大于匹配本身
+    static const std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
     std::smatch subMath;
     if(std::regex_match(line, subMath, patten))
     {
@@ -133,17 +196,24 @@ bool HttpRequest::parseRequstLine(const string& line)
 bool HttpRequest::parseHeader(const string& line)
 {
     // 匹配 "Key: Value"
-    std::regex patten("^([^:]*): ?(.*)$");
+    static const std::regex patten("^([^:]*): ?(.*)$");
     std::smatch subMath;
 
     if(std::regex_match(line, subMath, patten))
     {
-        m_header[subMath[1]] = subMath[2];
+        // 请求头名不区分大小写，统一存为小写，与 frame 的匹配方式一致
+        string key = subMath[1];
+        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        m_header[key] = subMath[2];
     }
     else
     {
-        // 空行 → 请求头结束，切换到解析 body
-        m_curState = CHECK_CONTENT;
+        // 空行 → 请求头结束；无请求体（如 GET）直接完成，否则切换到解析 body
+        auto it = m_header.find("content-length");
+        bool hasBody = m_mthod == "POST" && (it == m_header.end() || std::strtoul(it->second.c_str(), nullptr, 10) > 0);
+        m_curState = hasBody ? CHECK_CONTENT : CHECK_FINISH;
+        // 请求头结束，凭 Cookie 中的会话令牌认证
+        parseSession();
     }
 
     return true;
@@ -170,7 +240,7 @@ int HttpRequest::converHex(char ch)
 
 void HttpRequest::parsePostReq()
 {
-    if(m_mthod == "POST" && m_header["Content-Type"] == "application/x-www-form-urlencoded")
+    if(m_mthod == "POST" && m_header["content-type"] == "application/x-www-form-urlencoded")
     {
         // 解析 URL 编码的表单数据
         parseFromUrlEncoded();
@@ -178,23 +248,99 @@ void HttpRequest::parsePostReq()
         if(DEFAULT_HTML_TAG.count(m_path))
         {
             int flag = DEFAULT_HTML_TAG.find(m_path)->second;
+            if(flag == 1 && isAuthed())
+            {
+                // 已登录的会话不再校验口令
+                m_path = "/welcome.html";
+                return;
+            }
+
             if(flag == 0 || flag == 1)
             {
-                bool isLogin = (flag == 1);
-                if(userVerify(m_userInfo["username"], m_userInfo["password"], isLogin))
+                if(asyncVerify || (flag == 0 && asyncRegister))
                 {
-                    m_path = "/welcome.html";
+                    // 交给协程处理，避免数据库往返期间占用线程
+                    m_verifyTag = flag;
+                    return;
                 }
-                else
+
+                bool isLogin = (flag == 1);
+                bool ok;
                 {
-                    m_path = "/error.html";
+                    TraceScope trace(m_traceId, Trace::VERIFY);
+                    ok = userVerify(m_userInfo["username"], m_userInfo["password"], isLogin);
                 }
+                applyVerify(ok, isLogin);
             }
         }
 
     }
 }
 
+void HttpRequest::applyVerify(bool ok, bool isLogin)
+{
+    m_path = ok ? "/welcome.html" : "/error.html";
+
+    // 登录成功，下发会话令牌
+    if(ok && isLogin)
+    {
+        m_newSession = SessionStore::getInstance()->create(m_userInfo["username"]);
+    }
+}
+
+void HttpRequest::parseSession()
+{
+    string token = getCookie(SessionStore::COOKIE_NAME);
+    if(!token.empty() && SessionStore::getInstance()->lookup(token, &m_sessionUser))
+    {
+        // 已登录的用户访问登录页，直接进入欢迎页
+        if(m_mthod == "GET" && m_path == "/login.html")
+        {
+            m_path = "/welcome.html";
+        }
+    }
+}
+
+string HttpRequest::getCookie(const string& name) const
+{
+    auto it = m_header.find("cookie");
+    if(it == m_header.end()) return "";
+
+    // Cookie: a=1; sid=xxx; b=2
+    const string& cookies = it->second;
+    size_t pos = 0;
+    while(pos < cookies.size())
+    {
+        while(pos < cookies.size() && (cookies[pos] == ' ' || cookies[pos] == ';')) ++pos;
+
+        size_t end = cookies.find(';', pos);
+        if(end == string::npos) end = cookies.size();
+
+        size_t eq = cookies.find('=', pos);
+        if(eq != string::npos && eq < end && cookies.compare(pos, eq - pos, name) == 0 && eq - pos == name.size())
+        {
+            return cookies.substr(eq + 1, end - eq - 1);
+        }
+        pos = end;
+    }
+    return "";
+}
+
+Task<void> HttpRequest::verifyAsync()
+{
+    assert(needVerify());
+    bool isLogin = (m_verifyTag == 1);
+    m_verifyTag = -1;
+
+    bool ok;
+    {
+        // 跨越挂起点：结束时间记录在恢复协程的线程上
+        TraceScope trace(m_traceId, Trace::VERIFY);
+        ok = co_await userVerifyAsync(m_userInfo["username"], m_userInfo["password"], isLogin);
+    }
+    applyVerify(ok, isLogin);
+}
+
 void HttpRequest::parseFromUrlEncoded()
 {
     if(m_body.size() == 0) return;
@@ -268,52 +414,86 @@ bool HttpRequest::userVerify(const string& name, const string& pwd, bool isLogin
         std::cout << "name: " << name << " password: " << pwd << std::endl;
 #endif 
 
-    std::shared_ptr<MysqlConnection> mysql = DbConnsPool::getInstance()->getConnection();
-
-    assert(mysql);
-
-    bool flag = !isLogin ? true : false;
-    char sql[256] = { 0 };
+    // 最近登录过的用户直接在缓存中校验
+    CredentialCache* cache = CredentialCache::getInstance();
+    if(isLogin && cache->verify(name, pwd))
+    {
+        return true;
+    }
 
-    snprintf(sql, 256, "SELECT username, password FROM user WHERE username='%s' LIMIT 1", name.c_str());
-    
-    MYSQL_RES* res = mysql->query(sql);
-    if(res == nullptr)
+    // 具体的存储后端（MySQL / 内嵌 mmap 表）由配置决定
+    AuthStore* store = AuthStore::getInstance();
+    AuthStore::RESULT ret = isLogin ? store->verify(name, pwd) : store->registerUser(name, pwd);
+    if(ret != AuthStore::AUTH_OK)
     {
 #ifdef DEBUG
-        std::cout << "mysql query error!" << std::endl;
-#endif 
+        std::cout << "user verify failed: " << ret << std::endl;
+#endif
         return false;
     }
-    
-    while(MYSQL_ROW row = mysql_fetch_row(res))
-    {
-        string passwd(row[1]);
 
-        if(isLogin)
-        {
-            if(pwd == passwd) { flag = true; }
-            else
-            {
-                flag = false;
-            }
+    cache->put(name, pwd);
+    return true;
+}
 
-        }
+Task<bool> HttpRequest::userVerifyAsync(string name, string pwd, bool isLogin)
+{
+    if(name.empty() || pwd.empty() || name == " " || pwd == " " )
+    {
+        co_return false;
     }
 
-    if(!isLogin && flag)
+    CredentialCache* cache = CredentialCache::getInstance();
+    if(isLogin && cache->verify(name, pwd))
     {
-        bzero(sql, 256);
-        snprintf(sql, 256,"INSERT INTO user(username, password) VALUES('%s','%s')", name.c_str(), pwd.c_str());
-        if(!mysql->update(sql))
+        co_return true;
+    }
+
+    if(!isLogin)
+    {
+        // 注册走组提交，挂起到所在批次提交完成，等待期间线程去处理别的连接
+        RegisterBatcher::RESULT ret = co_await RegisterBatcher::getInstance()->submitAsync(name, pwd);
+        if(ret != RegisterBatcher::REG_OK)
         {
 #ifdef DEBUG
-        std::cout << "insert into error!" << std::endl;
-#endif 
-            return false;
+            std::cout << "register failed: " << ret << std::endl;
+#endif
+            co_return false;
         }
+
+        cache->put(name, pwd);
+        co_return true;
+    }
+
+    // 连接不够时在这里挂起排队，不占用线程
+    std::shared_ptr<AsyncMysqlConnection> mysql = co_await DbConnsPool::getInstance()->getAsyncConnection();
+    if(!mysql)
+    {
+        co_return false;
+    }
+
+    // 与同步路径共用预处理语句，参数二进制绑定，不再拼接 SQL
+    std::vector<string> params{name};
+    if(!co_await mysql->execute(MysqlConnection::STMT_SELECT_USER, std::move(params)))
+    {
+#ifdef DEBUG
+        std::cout << "mysql async query error!" << std::endl;
+#endif
+        co_return false;
+    }
+
+    bool flag = false;
+    std::vector<string> row;
+    while(mysql->fetch(MysqlConnection::STMT_SELECT_USER, row))
+    {
+        flag = (pwd == row[1]);
+    }
+
+    if(flag)
+    {
+        cache->put(name, pwd);
     }
-    return flag;
+    co_return flag;
 }
 
 string HttpRequest::path() const
@@ -362,9 +542,9 @@ string HttpRequest::getPostByKey(const char* key) const
 
 bool HttpRequest::isKeepAlive() const
 {
-    if(m_header.count("Connection"))
+    if(m_header.count("connection"))
     {
-        return m_header.find("Connection")->second == "keep-alive" && m_version == "1.1";
+        return m_header.find("connection")->second == "keep-alive" && m_version == "1.1";
     }
 
     return false;
@@ -6,11 +6,21 @@
 #include <string>
 #include <regex>
 #include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <algorithm>
 #include <mysql/mysql.h>
 #include <iostream>
 
 #include "../buffer/buffer.h"
 #include "../pool/sqlConnsPool/dbConnsPool.h"
+#include "../auth/credentialCache.h"
+#include "../auth/authStore.h"
+#include "../auth/registerBatcher.h"
+#include "../auth/sessionStore.h"
+#include "../utils/coTask.h"
+#include "../metrics/trace.h"
 
 using std::string;
 
@@ -41,6 +51,16 @@ public:
 
     };
 
+    /* 缓冲区中第一个请求的到达情况，解析前判断 */
+    enum FRAME
+    {
+        FRAME_HEADER = 0,           // 请求头未收全
+        FRAME_BODY,                 // 请求头已收全，请求体未收全
+        FRAME_COMPLETE,             // 完整请求
+        FRAME_HEADER_TOO_LARGE,     // 请求头超过上限
+        FRAME_BODY_TOO_LARGE,       // Content-Length 超过上限
+    };
+
 public:
     HttpRequest() { init();};
     ~HttpRequest() = default;
@@ -48,6 +68,8 @@ public:
     void init();
     bool parse(Buffer& buff);
 
+    static FRAME frame(const Buffer& buff, size_t maxHeader, size_t maxBody);
+
     string path() const;
     string& path();
     string method() const;
@@ -57,6 +79,18 @@ public:
 
     bool isKeepAlive() const;
 
+    string getCookie(const string& name) const;
+    bool isAuthed() const { return !m_sessionUser.empty(); }
+    const string& newSession() const { return m_newSession; }   // 本次登录新建的会话令牌
+
+    /* 异步模式下，登录/注册的校验推迟到协程中完成；MySQL 后端的注册总是推迟 */
+    bool needVerify() const { return m_verifyTag >= 0; }
+    void setTraceId(uint32_t id) { m_traceId = id; }
+    Task<void> verifyAsync();
+
+public:
+    static bool asyncVerify;        // 是否启用协程异步校验
+    static bool asyncRegister;      // 注册是否在协程中等待组提交（MySQL 后端）
 
 
 private:
@@ -68,7 +102,11 @@ private:
     void parsePostReq();
     void parseFromUrlEncoded();         // 处理 URL 编码
 
+    void applyVerify(bool ok, bool isLogin);
+    void parseSession();
+
     static bool userVerify(const string& name, const string& pwd, bool isLogin);
+    static Task<bool> userVerifyAsync(string name, string pwd, bool isLogin);
     static int converHex(char ch);      // 编码转换
 
 
@@ -76,13 +114,18 @@ private:
 
 private:
     CHECK_STATE m_curState;   // 记录当前状态
+    int m_verifyTag;          // 待异步校验的页面标签，-1 表示无
+    uint32_t m_traceId = 0;   // 所属连接的追踪 id
+
+    string m_sessionUser;     // 会话对应的用户，空表示未登录
+    string m_newSession;      // 本次登录新建的会话令牌
 
     string m_mthod;
     string m_path;
     string m_version;
     string m_body;
 
-    std::unordered_map<string, string> m_header;    // 存储请求头键值对
+    std::unordered_map<string, string> m_header;    // 存储请求头键值对，键为小写
     std::unordered_map<string, string> m_userInfo;    // 存在用户名和密码键值对
 
     static const std::unordered_set<string> DEFAULT_HTML;       // 存储默认的HTML路径
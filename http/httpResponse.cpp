@@ -29,6 +29,8 @@ const std::unordered_map<int, string> HttpResponse::CODE_STATUS =
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
+    { 431, "Request Header Fields Too Large" },
 };
 
 const std::unordered_map<int, string> HttpResponse::CODE_PATH = 
@@ -39,7 +41,7 @@ const std::unordered_map<int, string> HttpResponse::CODE_PATH =
 };
 
 HttpResponse::HttpResponse()
-:m_code(-1), m_isKeepAlive(false), m_path(""), m_strDir(""), m_fileAddr(nullptr)
+:m_code(-1), m_isKeepAlive(false), m_keepAliveTimeout(0), m_keepAliveMax(0), m_path(""), m_strDir(""), m_hasContent(false), m_fileAddr(nullptr)
 {
 
 }
@@ -59,14 +61,37 @@ void HttpResponse::init(const string& srcDir, string& path, bool isKeepAlive, in
 
     m_code = code;
     m_isKeepAlive = isKeepAlive;
+    m_keepAliveTimeout = 0;
+    m_keepAliveMax = 0;
     m_path = path;
     m_strDir = srcDir;
+    m_cookie.clear();
+    m_hasContent = false;
+    m_content.clear();
+    m_contentType.clear();
     m_fileAddr = nullptr;
     m_fileStat = { 0 };
 }
 
+void HttpResponse::setContent(const string& body, const string& type)
+{
+    m_hasContent = true;
+    m_content = body;
+    m_contentType = type;
+}
+
 void HttpResponse::makeResponse(Buffer& buff)
 {
+    if(m_hasContent)
+    {
+        // 内存响应体直接写入缓冲区
+        addStateLine(buff);
+        addHeader(buff);
+        buff.insert("Content-length: " + std::to_string(m_content.size()) + "\r\n\r\n");
+        buff.insert(m_content);
+        return;
+    }
+
     // 1.检查请求的文件是否存在，是否为目录，是否有权限读
     if(stat((m_strDir + m_path).data(), &m_fileStat) < 0 || S_ISDIR(m_fileStat.st_mode))
     {
@@ -138,13 +163,26 @@ void HttpResponse::addHeader(Buffer& buff)
     if(m_isKeepAlive)
     {
         buff.insert("keep-alive\r\n");
-        buff.insert("keep-alive: max=6, timeout=120\r\n");  // 长连接参数
+        // 长连接参数：实际生效的空闲超时和本连接剩余请求数
+        if(m_keepAliveTimeout > 0)
+        {
+            buff.insert("Keep-Alive: timeout=" + std::to_string(m_keepAliveTimeout) + ", max=" + std::to_string(m_keepAliveMax) + "\r\n");
+        }
+        else
+        {
+            buff.insert("Keep-Alive: max=" + std::to_string(m_keepAliveMax) + "\r\n");
+        }
     }
     else
     {
         buff.insert("close\r\n");
     }
 
+    if(!m_cookie.empty())
+    {
+        buff.insert("Set-Cookie: " + m_cookie + "\r\n");
+    }
+
     buff.insert("Content-type: " + getFileType() + "\r\n");
 }
 
@@ -180,6 +218,11 @@ void HttpResponse::unmap()
 
 string HttpResponse::getFileType()
 {
+    if(m_hasContent)
+    {
+        return m_contentType;
+    }
+
     string::size_type idx = m_path.find_last_of(".");
     if(idx == string::npos)
     {
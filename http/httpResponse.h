@@ -26,6 +26,11 @@ public:
     size_t fileLen() const;
     void errorContent(Buffer& buff, string message);
     int code() const { return m_code;}
+    bool isKeepAlive() const { return m_isKeepAlive; }
+    /* 长连接参数，写入 Keep-Alive 头：空闲超时（秒，0 不写）和本连接剩余可用请求数 */
+    void setKeepAlive(int timeoutSec, int max) { m_keepAliveTimeout = timeoutSec; m_keepAliveMax = max; }
+    void setCookie(const string& cookie) { m_cookie = cookie; }
+    void setContent(const string& body, const string& type);    // 内存中生成的响应体，不读文件
 
 
 private:
@@ -44,9 +49,15 @@ private:
 private:
     int m_code;                 // HTTP响应状态码
     bool m_isKeepAlive;         // 是否保持连接
+    int m_keepAliveTimeout;     // 通告的空闲超时（秒）
+    int m_keepAliveMax;         // 通告的剩余请求数
 
     string m_path;              // 待响应的文件路径
     string m_strDir;            // 静态资源地址
+    string m_cookie;            // Set-Cookie 头的内容，空表示不下发
+    bool m_hasContent;          // 是否使用内存响应体
+    string m_content;           // 内存响应体
+    string m_contentType;
 
     char* m_fileAddr;           // map映射文件地址
     struct stat m_fileStat;     // 映射文件状态信息
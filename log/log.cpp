@@ -0,0 +1,451 @@
+#include "log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <iostream>
+
+namespace
+{
+
+const char* KIND_FILE[] = { "access.log", "error.log" };
+const char* LEVEL_NAME[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+
+// 单条记录格式化后的上限，超出部分截断
+const size_t MAX_RECORD = 1024;
+
+}
+
+thread_local Log::LocalHolder Log::t_holder;
+
+Log* Log::getInstance()
+{
+    // 不析构：线程退出时的 LocalHolder 可能晚于静态对象析构
+    static Log* log = new Log;
+    return log;
+}
+
+Log::Log()
+:m_enable(true), m_access(true), m_level(LEVEL_INFO), m_dir("logs"), m_ringSize(1 << 20),
+m_flushInterval(200), m_flushBytes(256 * 1024), m_rotateBytes(64ull << 20), m_maxFiles(5),
+m_retiredDropped(0), m_urgent(false), m_stop(false), m_written(0), m_cachedSec(-1)
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "Log use default configuration..." << std::endl;
+#endif
+    }
+
+    if(!m_enable) return;
+
+    // 环大小取 2 的幂，便于用掩码回绕
+    size_t size = 4096;
+    while(size < m_ringSize) size <<= 1;
+    m_ringSize = size;
+    m_flushInterval = std::max(m_flushInterval, 1);
+    m_maxFiles = std::max(m_maxFiles, 1);
+
+    string dir = m_dir[0] == '/' ? m_dir : getSrcPath() + "/" + m_dir;
+    if(mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST)
+    {
+#ifdef DEBUG
+        std::cout << "Log mkdir " << dir << " failed: " << strerror(errno) << std::endl;
+#endif
+        m_enable = false;
+        return;
+    }
+
+    for(int i = 0; i < KIND_NUM; ++i)
+    {
+        m_out[i].path = dir + "/" + KIND_FILE[i];
+        m_out[i].batch.reserve(m_flushBytes + MAX_RECORD * 2);
+        if(!openOutput(m_out[i]))
+        {
+            m_enable = false;
+            return;
+        }
+    }
+
+    m_flushThread = std::thread(&Log::flushLoop, this);
+    std::atexit([]{ Log::getInstance()->flush(); });
+}
+
+Log::LocalHolder::~LocalHolder()
+{
+    // 环由后台线程在读空后释放
+    if(ring) ring->retired.store(true, std::memory_order_release);
+}
+
+bool Log::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "log.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << m_configPath << std::endl;
+#endif
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "enable")
+            {
+                m_enable = std::stoi(value) != 0;
+            }
+            else if(key == "access")
+            {
+                m_access = std::stoi(value) != 0;
+            }
+            else if(key == "level")
+            {
+                std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+                for(int i = LEVEL_DEBUG; i <= LEVEL_ERROR; ++i)
+                {
+                    if(value == LEVEL_NAME[i]) m_level = static_cast<LEVEL>(i);
+                }
+            }
+            else if(key == "dir")
+            {
+                if(!value.empty()) m_dir = value;
+            }
+            else if(key == "ringsize")
+            {
+                m_ringSize = std::stoul(value) * 1024;
+            }
+            else if(key == "flushinterval")
+            {
+                m_flushInterval = std::stoi(value);
+            }
+            else if(key == "flushsize")
+            {
+                m_flushBytes = std::stoul(value) * 1024;
+            }
+            else if(key == "rotatesize")
+            {
+                m_rotateBytes = std::stoull(value) << 20;
+            }
+            else if(key == "maxfiles")
+            {
+                m_maxFiles = std::stoi(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+Log::Ring* Log::local()
+{
+    if(t_holder.ring) return t_holder.ring;
+
+    Ring* ring = new Ring;
+    ring->data = new char[m_ringSize];
+    ring->mask = m_ringSize - 1;
+
+    std::lock_guard<std::mutex> locker(m_ringsMtx);
+    m_rings.push_back(ring);
+    t_holder.ring = ring;
+    return ring;
+}
+
+void Log::access(const char* fmt, ...)
+{
+    if(!accessEnabled()) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    push(KIND_ACCESS, LEVEL_INFO, fmt, ap);
+    va_end(ap);
+}
+
+void Log::write(LEVEL level, const char* fmt, ...)
+{
+    if(!isOpen(level)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    push(KIND_ERROR, level, fmt, ap);
+    va_end(ap);
+}
+
+void Log::push(KIND kind, LEVEL level, const char* fmt, va_list ap)
+{
+    char buf[MAX_RECORD];
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    if(n < 0) return;
+    n = std::min<int>(n, sizeof(buf) - 1);
+
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    RecordHeader hdr{static_cast<uint32_t>(n), static_cast<uint8_t>(kind), static_cast<uint8_t>(level), 0,
+        static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000};
+
+    Ring* ring = local();
+    uint64_t cap = ring->mask + 1;
+    uint64_t need = sizeof(hdr) + n;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+
+    // 空间不足直接丢弃，不等待后台线程
+    if(cap - (head - tail) < need)
+    {
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto copyIn = [ring, cap](uint64_t pos, const void* src, size_t len)
+    {
+        size_t off = pos & ring->mask;
+        size_t first = std::min<size_t>(len, cap - off);
+        memcpy(ring->data + off, src, first);
+        memcpy(ring->data, static_cast<const char*>(src) + first, len - first);
+    };
+
+    copyIn(head, &hdr, sizeof(hdr));
+    copyIn(head + sizeof(hdr), buf, n);
+    ring->head.store(head + need, std::memory_order_release);
+
+    // 超过半满时唤醒后台线程，每轮只通知一次
+    if(head + need - tail > cap / 2 && !m_urgent.exchange(true, std::memory_order_relaxed))
+    {
+        m_flushCV.notify_one();
+    }
+}
+
+void Log::flushLoop()
+{
+    while(!m_stop.load())
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_flushMtx);
+            m_flushCV.wait_for(locker, std::chrono::milliseconds(m_flushInterval),
+                [this]{ return m_urgent.load() || m_stop.load(); });
+        }
+        m_urgent.store(false);
+
+        // 按时间间隔落盘：不论批量缓冲是否攒满
+        drain();
+        for(Output& out : m_out)
+        {
+            writeOut(out);
+        }
+    }
+
+    drain();
+    for(Output& out : m_out)
+    {
+        writeOut(out);
+        if(out.fd >= 0)
+        {
+            fdatasync(out.fd);
+        }
+    }
+}
+
+bool Log::drain()
+{
+    bool any = false;
+
+    // 只在复制环列表和摘除退出线程的环时加锁，写盘期间首次记录日志的线程不会被阻塞
+    // 环只由本线程消费和释放，锁外读取是安全的
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> locker(m_ringsMtx);
+        rings = m_rings;
+    }
+
+    std::vector<Ring*> finished;
+    for(Ring* ring : rings)
+    {
+        bool retired = ring->retired.load(std::memory_order_acquire);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t cap = ring->mask + 1;
+
+        auto copyOut = [ring, cap](uint64_t pos, void* dst, size_t len)
+        {
+            size_t off = pos & ring->mask;
+            size_t first = std::min<size_t>(len, cap - off);
+            memcpy(dst, ring->data + off, first);
+            memcpy(static_cast<char*>(dst) + first, ring->data, len - first);
+        };
+
+        while(tail < head)
+        {
+            RecordHeader hdr;
+            copyOut(tail, &hdr, sizeof(hdr));
+
+            Output& out = m_out[hdr.kind < KIND_NUM ? hdr.kind : KIND_ERROR];
+            appendTime(out.batch, hdr.timeUs);
+            if(hdr.kind != KIND_ACCESS)
+            {
+                out.batch += '[';
+                out.batch += LEVEL_NAME[hdr.level <= LEVEL_ERROR ? hdr.level : LEVEL_ERROR];
+                out.batch += "] ";
+            }
+
+            size_t pos = out.batch.size();
+            out.batch.resize(pos + hdr.len);
+            copyOut(tail + sizeof(hdr), &out.batch[pos], hdr.len);
+            out.batch += '\n';
+
+            tail += sizeof(hdr) + hdr.len;
+            m_written.fetch_add(1, std::memory_order_relaxed);
+            any = true;
+
+            // 按大小落盘
+            if(out.batch.size() >= m_flushBytes)
+            {
+                ring->tail.store(tail, std::memory_order_release);
+                writeOut(out);
+            }
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        // 线程已退出且读空，释放环
+        if(retired && tail == head)
+        {
+            finished.push_back(ring);
+        }
+    }
+
+    if(!finished.empty())
+    {
+        std::lock_guard<std::mutex> locker(m_ringsMtx);
+        for(Ring* ring : finished)
+        {
+            m_retiredDropped += ring->dropped.load(std::memory_order_relaxed);
+            m_rings.erase(std::remove(m_rings.begin(), m_rings.end(), ring), m_rings.end());
+            delete[] ring->data;
+            delete ring;
+        }
+    }
+
+    return any;
+}
+
+void Log::appendTime(string& dst, uint64_t timeUs)
+{
+    int64_t sec = static_cast<int64_t>(timeUs / 1000000);
+    if(sec != m_cachedSec)
+    {
+        time_t t = static_cast<time_t>(sec);
+        struct tm tmv;
+        localtime_r(&t, &tmv);
+        strftime(m_cachedTime, sizeof(m_cachedTime), "%Y-%m-%d %H:%M:%S", &tmv);
+        m_cachedSec = sec;
+    }
+
+    char frac[16];
+    snprintf(frac, sizeof(frac), ".%06u ", static_cast<unsigned>(timeUs % 1000000));
+    dst += m_cachedTime;
+    dst += frac;
+}
+
+void Log::writeOut(Output& out)
+{
+    if(out.batch.empty() || out.fd < 0) return;
+
+    if(out.size > 0 && out.size + out.batch.size() > m_rotateBytes)
+    {
+        rotate(out);
+        if(out.fd < 0)
+        {
+            out.batch.clear();
+            return;
+        }
+    }
+
+    size_t off = 0;
+    while(off < out.batch.size())
+    {
+        ssize_t n = ::write(out.fd, out.batch.data() + off, out.batch.size() - off);
+        if(n < 0)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+        off += n;
+    }
+
+    out.size += off;
+    out.batch.clear();
+}
+
+void Log::rotate(Output& out)
+{
+    close(out.fd);
+    out.fd = -1;
+
+    // access.log -> access.log.1 -> ... -> access.log.N，最旧的被覆盖
+    for(int i = m_maxFiles - 1; i >= 1; --i)
+    {
+        string from = out.path + "." + std::to_string(i);
+        string to = out.path + "." + std::to_string(i + 1);
+        rename(from.c_str(), to.c_str());
+    }
+    rename(out.path.c_str(), (out.path + ".1").c_str());
+
+    openOutput(out);
+}
+
+bool Log::openOutput(Output& out)
+{
+    out.fd = open(out.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(out.fd < 0)
+    {
+#ifdef DEBUG
+        std::cout << "Log open " << out.path << " failed: " << strerror(errno) << std::endl;
+#endif
+        return false;
+    }
+
+    struct stat st;
+    out.size = fstat(out.fd, &st) == 0 ? st.st_size : 0;
+    return true;
+}
+
+void Log::flush()
+{
+    if(!m_flushThread.joinable()) return;
+
+    m_stop.store(true);
+    m_flushCV.notify_one();
+    m_flushThread.join();
+}
+
+uint64_t Log::getDropped()
+{
+    std::lock_guard<std::mutex> locker(m_ringsMtx);
+    uint64_t total = m_retiredDropped;
+    for(Ring* ring : m_rings)
+    {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
@@ -0,0 +1,151 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdarg>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  异步日志：访问日志 + 错误日志
+ *  - 每个线程一个无锁 SPSC 字节环（本线程写、后台线程读），热路径只有一次格式化和 memcpy
+ *  - 环满时丢弃并计数，绝不阻塞请求线程
+ *  - 后台线程按时间间隔或攒够字节数时批量 write，文件超过大小后滚动
+ */
+class Log
+{
+public:
+    enum LEVEL
+    {
+        LEVEL_DEBUG = 0,
+        LEVEL_INFO,
+        LEVEL_WARN,
+        LEVEL_ERROR,
+    };
+
+    enum KIND
+    {
+        KIND_ACCESS = 0,
+        KIND_ERROR,
+        KIND_NUM,
+    };
+
+public:
+    static Log* getInstance();
+
+    bool isOpen(LEVEL level) const { return m_enable && level >= m_level; }
+    bool accessEnabled() const { return m_enable && m_access; }
+
+    void access(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    void write(LEVEL level, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+    void flush();               // 立即落盘并停止后台线程，进程退出前调用
+
+    uint64_t getWritten() const { return m_written.load(std::memory_order_relaxed); }
+    uint64_t getDropped();
+
+private:
+    Log();
+    ~Log() = default;
+    Log(const Log&) = delete;
+    Log& operator=(const Log&) = delete;
+
+    bool loadConfigFile();
+
+    /* 每条记录的头部，后接 len 字节文本 */
+    struct RecordHeader
+    {
+        uint32_t len;
+        uint8_t kind;
+        uint8_t level;
+        uint16_t reserved;
+        uint64_t timeUs;        // 墙上时间，由后台线程格式化
+    };
+
+    struct Ring
+    {
+        char* data = nullptr;
+        uint64_t mask = 0;
+        alignas(64) std::atomic<uint64_t> head{0};      // 生产者写入位置
+        alignas(64) std::atomic<uint64_t> tail{0};      // 消费者读取位置
+        alignas(64) std::atomic<uint64_t> dropped{0};   // 仅生产者写
+        std::atomic<bool> retired{false};               // 所属线程已退出
+    };
+
+    struct LocalHolder
+    {
+        Ring* ring = nullptr;
+        ~LocalHolder();
+    };
+
+    struct Output
+    {
+        string path;
+        int fd = -1;
+        uint64_t size = 0;
+        string batch;
+    };
+
+    static thread_local LocalHolder t_holder;
+
+    Ring* local();
+    void push(KIND kind, LEVEL level, const char* fmt, va_list ap);
+
+    void flushLoop();
+    bool drain();                               // 把所有环的数据格式化进批量缓冲，返回是否有数据
+    void writeOut(Output& out);
+    void rotate(Output& out);
+    bool openOutput(Output& out);
+    void appendTime(string& dst, uint64_t timeUs);
+
+private:
+    string m_configPath;
+
+    bool m_enable;
+    bool m_access;
+    LEVEL m_level;
+    string m_dir;
+    size_t m_ringSize;          // 每线程环大小（字节）
+    int m_flushInterval;        // 毫秒
+    size_t m_flushBytes;        // 批量缓冲达到该大小立即写
+    uint64_t m_rotateBytes;
+    int m_maxFiles;
+
+    std::mutex m_ringsMtx;
+    std::vector<Ring*> m_rings;
+    uint64_t m_retiredDropped;
+
+    Output m_out[KIND_NUM];
+
+    std::mutex m_flushMtx;
+    std::condition_variable m_flushCV;
+    std::atomic<bool> m_urgent;     // 某个环已过半，提前唤醒后台线程
+    std::atomic<bool> m_stop;
+    std::thread m_flushThread;
+
+    std::atomic<uint64_t> m_written;
+
+    /* 时间格式化缓存：同一秒内只格式化一次 */
+    int64_t m_cachedSec;
+    char m_cachedTime[32];
+};
+
+#define LOG_BASE(level, fmt, ...) \
+    do { Log* _log = Log::getInstance(); if(_log->isOpen(level)) _log->write(level, fmt, ##__VA_ARGS__); } while(0)
+
+#define LOG_DEBUG(fmt, ...) LOG_BASE(Log::LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)  LOG_BASE(Log::LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...)  LOG_BASE(Log::LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...) LOG_BASE(Log::LEVEL_ERROR, fmt, ##__VA_ARGS__)
+
+#endif
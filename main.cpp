@@ -1,7 +1,35 @@
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+
 #include "server/webserver.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-    Webserver server(9090, 3, 60000, false);
+    int port = 9090;
+    int trigMode = 3;
+    int timeoutMS = 60000;
+    bool optLinger = false;
+    std::string unixPath;
+
+    // -p 端口  -m 触发模式(0~3)  -t 超时(ms)  -l 优雅关闭(0/1)  -u Unix 域套接字路径（覆盖配置）
+    int opt;
+    while((opt = getopt(argc, argv, "p:m:t:l:u:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 'm': trigMode = atoi(optarg); break;
+            case 't': timeoutMS = atoi(optarg); break;
+            case 'l': optLinger = atoi(optarg) != 0; break;
+            case 'u': unixPath = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-m trigMode] [-t timeoutMS] [-l optLinger] [-u unixPath]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    Webserver server(port, trigMode, timeoutMS, optLinger, unixPath);
     server.run();
-}
\ No newline at end of file
+}
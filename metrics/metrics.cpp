@@ -0,0 +1,332 @@
+#include "metrics.h"
+
+const char* Metrics::PATH = "/metrics";
+
+namespace
+{
+
+const char* COUNTER_NAME[] =
+{
+    "webserver_accepts_total",
+    "webserver_requests_total",
+    "webserver_bytes_in_total",
+    "webserver_bytes_out_total",
+    "webserver_timer_expirations_total",
+    "webserver_loop_stalls_total",
+    "webserver_loop_saturated_total",
+    "webserver_shed_overload_total",
+    "webserver_shed_queue_full_total",
+    "webserver_shed_conn_limit_total",
+    "webserver_slow_header_closes_total",
+    "webserver_slow_body_closes_total",
+    "webserver_slow_drain_closes_total",
+    "webserver_ip_conn_limit_rejects_total",
+    "webserver_ip_conn_rate_rejects_total",
+    "webserver_ip_req_rate_rejects_total",
+    "webserver_accept_emfile_total",
+    "webserver_completions_total",
+    "webserver_keepalive_refused_total",
+    "webserver_remote_node_tasks_total",
+    "webserver_buffer_rehome_total",
+    "webserver_busy_poll_hits_total",
+    "webserver_busy_poll_sleeps_total",
+    "webserver_inline_requests_total",
+    "webserver_corked_responses_total",
+};
+
+const char* COUNTER_HELP[] =
+{
+    "Accepted client connections.",
+    "HTTP requests processed.",
+    "Bytes read from clients.",
+    "Bytes written to clients.",
+    "Idle connections closed by the timer.",
+    "Event loop iterations the watchdog caught exceeding the stall threshold.",
+    "epoll_wait calls that returned maxEvent events.",
+    "Requests answered with 503 because task queue delay stayed above the CoDel target.",
+    "Requests answered with 503 because the task queue was full.",
+    "Connections answered with 503 because the connection limit was reached.",
+    "Connections closed for missing the request header deadline or minimum rate.",
+    "Connections closed for missing the request body deadline or minimum rate.",
+    "Connections closed for missing the response drain deadline or minimum rate.",
+    "Connections rejected with 429 because the source IP hit its concurrent connection limit.",
+    "Connections rejected with 429 because the source IP exceeded its connection rate.",
+    "Requests rejected with 429 because the source IP exceeded its request rate.",
+    "Connections accepted through the reserved fd and closed because the process ran out of descriptors.",
+    "Worker completions (rearm read, rearm write, close) applied by the event loop.",
+    "Keep-alive requests answered with Connection: close because of the request cap, connection pressure or an upgrade.",
+    "Tasks a pinned worker ran for a connection homed on another NUMA node.",
+    "Connection buffers reallocated on the NUMA node of the worker serving them.",
+    "Event loop spins in busy-poll mode that found events before the budget ran out.",
+    "Event loop spins in busy-poll mode that exhausted the budget and fell back to a blocking wait.",
+    "Requests parsed and answered on the event loop thread without a thread pool hop.",
+    "File responses sent with TCP_CORK so headers and the first body segment share full-sized segments.",
+};
+
+const char* HISTOGRAM_NAME[] =
+{
+    "webserver_parse_seconds",
+    "webserver_queue_wait_seconds",
+    "webserver_db_wait_seconds",
+    "webserver_db_query_seconds",
+    "webserver_loop_events_per_wait",
+    "webserver_loop_dispatch_seconds",
+    "webserver_loop_timer_seconds",
+    "webserver_loop_stall_seconds",
+    "webserver_loop_completions_per_iteration",
+};
+
+const char* HISTOGRAM_HELP[] =
+{
+    "Time spent parsing a request and building its response.",
+    "Time a task waited in the thread pool queue.",
+    "Time spent waiting for a database connection.",
+    "Time spent executing a database statement.",
+    "Events returned by one epoll_wait call.",
+    "Time the event loop spent dispatching events in one iteration.",
+    "Time the event loop spent running timers in one iteration.",
+    "Busy time of event loop iterations that exceeded the stall threshold.",
+    "Worker completions applied by one event loop iteration.",
+};
+
+// 渲染时的换算除数：时间类为微秒转秒，计数类保持原值
+const double HISTOGRAM_UNIT[] = { 1e6, 1e6, 1e6, 1e6, 1, 1e6, 1e6, 1e6, 1 };
+
+const double QUANTILES[] = { 0.5, 0.9, 0.99, 0.999 };
+
+}
+
+thread_local Metrics::LocalHolder Metrics::t_holder;
+
+Metrics::Registry& Metrics::registry()
+{
+    // 不析构：线程退出时的 LocalHolder 可能晚于静态对象析构
+    static Registry* reg = new Registry;
+    return *reg;
+}
+
+Metrics::LocalHolder::~LocalHolder()
+{
+    destroyed = true;
+    if(block == nullptr) return;
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> locker(reg.mtx);
+    mergeInto(reg.retired, *block);
+    reset(*block);
+    block->inUse = false;
+
+    // 块可能马上被别的线程取走，本线程之后的记录不能再写进去
+    block = nullptr;
+}
+
+Metrics::ThreadBlock* Metrics::local()
+{
+    if(t_holder.block) return t_holder.block;
+    if(t_holder.destroyed) return nullptr;
+
+    // 每个线程只在第一次记录时加锁注册一次，优先复用已退出线程的块
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> locker(reg.mtx);
+    for(ThreadBlock* b : reg.blocks)
+    {
+        if(!b->inUse)
+        {
+            b->inUse = true;
+            t_holder.block = b;
+            return b;
+        }
+    }
+
+    ThreadBlock* b = new ThreadBlock;
+    b->inUse = true;
+    reg.blocks.push_back(b);
+    t_holder.block = b;
+    return b;
+}
+
+void Metrics::inc(COUNTER c, uint64_t n)
+{
+    ThreadBlock* b = local();
+    if(b) b->counters[c].add(n);
+}
+
+void Metrics::observe(HISTOGRAM h, uint64_t us)
+{
+    ThreadBlock* b = local();
+    if(b == nullptr) return;
+
+    Histogram& hist = b->hists[h];
+    hist.count.add(1);
+    hist.sum.add(us);
+    bump(hist.buckets[bucketOf(us)]);
+}
+
+void Metrics::status(int code)
+{
+    ThreadBlock* b = local();
+    if(b == nullptr) return;
+
+    b->counters[REQUESTS].add(1);
+    if(code >= 0 && code < STATUS_NUM)
+    {
+        bump(b->status[code]);
+    }
+}
+
+int Metrics::bucketOf(uint64_t v)
+{
+    if(v < 16) return static_cast<int>(v);
+
+    int e = 63 - __builtin_clzll(v);
+    int sub = static_cast<int>((v >> (e - 3)) & (SUB_BUCKETS - 1));
+    return 16 + (e - 4) * SUB_BUCKETS + sub;
+}
+
+uint64_t Metrics::bucketUpper(int idx)
+{
+    if(idx < 16) return idx;
+
+    int e = (idx - 16) / SUB_BUCKETS + 4;
+    uint64_t sub = (idx - 16) % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub) << (e - 3);
+    return lower + (uint64_t(1) << (e - 3)) - 1;
+}
+
+void Metrics::mergeInto(ThreadBlock& dst, const ThreadBlock& src)
+{
+    for(int i = 0; i < COUNTER_NUM; ++i)
+    {
+        dst.counters[i].add(src.counters[i].get());
+    }
+    for(int h = 0; h < HISTOGRAM_NUM; ++h)
+    {
+        dst.hists[h].count.add(src.hists[h].count.get());
+        dst.hists[h].sum.add(src.hists[h].sum.get());
+        for(int i = 0; i < BUCKET_NUM; ++i)
+        {
+            bump(dst.hists[h].buckets[i], src.hists[h].buckets[i].load(std::memory_order_relaxed));
+        }
+    }
+    for(int i = 0; i < STATUS_NUM; ++i)
+    {
+        bump(dst.status[i], src.status[i].load(std::memory_order_relaxed));
+    }
+}
+
+void Metrics::reset(ThreadBlock& b)
+{
+    for(int i = 0; i < COUNTER_NUM; ++i)
+    {
+        b.counters[i].value.store(0, std::memory_order_relaxed);
+    }
+    for(int h = 0; h < HISTOGRAM_NUM; ++h)
+    {
+        b.hists[h].count.value.store(0, std::memory_order_relaxed);
+        b.hists[h].sum.value.store(0, std::memory_order_relaxed);
+        for(int i = 0; i < BUCKET_NUM; ++i)
+        {
+            b.hists[h].buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    for(int i = 0; i < STATUS_NUM; ++i)
+    {
+        b.status[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::addCollector(const string& name, const string& type, const string& help, std::function<double()> fn)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> locker(reg.mtx);
+    for(Collector& c : reg.collectors)
+    {
+        if(c.name == name)
+        {
+            c = Collector{name, type, help, std::move(fn)};
+            return;
+        }
+    }
+    reg.collectors.push_back(Collector{name, type, help, std::move(fn)});
+}
+
+string Metrics::render()
+{
+    // 汇总到临时块，堆上分配避免大对象占栈
+    std::unique_ptr<ThreadBlock> total(new ThreadBlock);
+    std::vector<Collector> collectors;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> locker(reg.mtx);
+        mergeInto(*total, reg.retired);
+        for(ThreadBlock* b : reg.blocks)
+        {
+            mergeInto(*total, *b);
+        }
+        collectors = reg.collectors;
+    }
+
+    string out;
+    out.reserve(8192);
+
+    for(int i = 0; i < COUNTER_NUM; ++i)
+    {
+        out += string("# HELP ") + COUNTER_NAME[i] + " " + COUNTER_HELP[i] + "\n";
+        out += string("# TYPE ") + COUNTER_NAME[i] + " counter\n";
+        out += string(COUNTER_NAME[i]) + " " + std::to_string(total->counters[i].get()) + "\n";
+    }
+
+    out += "# HELP webserver_responses_total HTTP responses by status code.\n";
+    out += "# TYPE webserver_responses_total counter\n";
+    for(int i = 0; i < STATUS_NUM; ++i)
+    {
+        uint64_t n = total->status[i].load(std::memory_order_relaxed);
+        if(n)
+        {
+            out += "webserver_responses_total{code=\"" + std::to_string(i) + "\"} " + std::to_string(n) + "\n";
+        }
+    }
+
+    char num[64];
+    for(int h = 0; h < HISTOGRAM_NUM; ++h)
+    {
+        const Histogram& hist = total->hists[h];
+        uint64_t count = hist.count.get();
+
+        out += string("# HELP ") + HISTOGRAM_NAME[h] + " " + HISTOGRAM_HELP[h] + "\n";
+        out += string("# TYPE ") + HISTOGRAM_NAME[h] + " summary\n";
+
+        // 分位数取所在桶的上界
+        for(double q : QUANTILES)
+        {
+            uint64_t target = static_cast<uint64_t>(q * count + 0.5);
+            uint64_t seen = 0;
+            uint64_t value = 0;
+            for(int i = 0; i < BUCKET_NUM && count; ++i)
+            {
+                seen += hist.buckets[i].load(std::memory_order_relaxed);
+                if(seen >= target && seen > 0)
+                {
+                    value = bucketUpper(i);
+                    break;
+                }
+            }
+            snprintf(num, sizeof(num), "{quantile=\"%g\"} %.6f\n", q, value / HISTOGRAM_UNIT[h]);
+            out += string(HISTOGRAM_NAME[h]) + num;
+        }
+
+        snprintf(num, sizeof(num), "_sum %.6f\n", hist.sum.get() / HISTOGRAM_UNIT[h]);
+        out += string(HISTOGRAM_NAME[h]) + num;
+        out += string(HISTOGRAM_NAME[h]) + "_count " + std::to_string(count) + "\n";
+    }
+
+    for(const Collector& c : collectors)
+    {
+        snprintf(num, sizeof(num), " %.17g\n", c.fn());
+        out += "# HELP " + c.name + " " + c.help + "\n";
+        out += "# TYPE " + c.name + " " + c.type + "\n";
+        out += c.name + num;
+    }
+
+    return out;
+}
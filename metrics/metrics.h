@@ -0,0 +1,158 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+
+using std::string;
+
+/**
+ *  运行指标：每个线程一块按缓存行对齐的计数区，热路径上只做本线程的 relaxed 读写，无锁无原子 RMW
+ *  读取（/metrics）时加锁遍历所有线程块求和，线程退出时其数值并入 retired 块
+ *  延迟直方图为 HDR 风格的对数线性分桶（每个 2 的幂区间 8 个子桶，单位微秒）
+ */
+class Metrics
+{
+public:
+    enum COUNTER
+    {
+        ACCEPTS = 0,            // accept 成功的连接数
+        REQUESTS,               // 处理的请求数
+        BYTES_IN,               // 读入字节数
+        BYTES_OUT,              // 写出字节数
+        TIMER_EXPIRED,          // 空闲超时关闭的连接数
+        LOOP_STALLS,            // 看门狗发现的事件循环卡顿次数
+        LOOP_SATURATED,         // epoll_wait 返回数等于 maxEvent 的次数（说明 maxEvent 偏小）
+        SHED_OVERLOAD,          // CoDel 判定过载而直接回 503 的请求数
+        SHED_QUEUE_FULL,        // 任务队列已满而直接回 503 的请求数
+        SHED_CONN_LIMIT,        // 连接数达到上限而回 503 的连接数
+        SLOW_HEADER,            // 请求头超过截止时间（含最低速率）被关闭的连接数
+        SLOW_BODY,              // 请求体超过截止时间被关闭的连接数
+        SLOW_DRAIN,             // 响应发送超过截止时间被关闭的连接数
+        IP_CONN_LIMIT,          // 单 IP 并发连接数超限被拒绝的连接数
+        IP_CONN_RATE,           // 单 IP 新建连接速率超限被拒绝的连接数
+        IP_REQ_RATE,            // 单 IP 请求速率超限被拒绝的请求数
+        ACCEPT_EMFILE,          // fd 耗尽时借预留 fd 接受并关闭的连接数
+        COMPLETIONS,            // 反应堆处理的工作线程完成（重新监听读/写、关闭）
+        KEEPALIVE_REFUSED,      // 客户端要求长连接、但因请求数上限/连接压力/升级回 Connection: close 的响应
+        REMOTE_TASKS,           // 启用 CPU 绑定时，工作线程执行的其他 NUMA 节点连接的任务数
+        BUFFER_REHOMED,         // 连接缓冲区迁到处理它的工作线程所在节点的次数
+        BUSY_POLL_HITS,         // 低延迟模式下零超时轮询等到事件的次数
+        BUSY_POLL_SLEEPS,       // 轮询预算用完仍无事件、转为阻塞等待的次数
+        INLINE_REQUESTS,        // 在反应堆上直接处理、未经线程池的请求数
+        CORKED_RESPONSES,       // 以 TCP_CORK 合并响应头和文件首段发送的响应数
+        COUNTER_NUM,
+    };
+
+    enum HISTOGRAM
+    {
+        PARSE_TIME = 0,         // 请求解析 + 生成响应
+        QUEUE_WAIT,             // 任务在线程池队列中的等待时间
+        DB_WAIT,                // 获取数据库连接的等待时间
+        DB_QUERY,               // 数据库语句执行时间
+        LOOP_EVENTS,            // 每次 epoll_wait 返回的事件数（单位：个，非微秒）
+        LOOP_DISPATCH,          // 每轮分发事件的耗时
+        LOOP_TIMER,             // 每轮处理定时器的耗时
+        LOOP_STALL_TIME,        // 超过卡顿阈值的单轮忙碌时长
+        LOOP_COMPLETIONS,       // 每轮处理的完成数（单位：个，非微秒）
+        HISTOGRAM_NUM,
+    };
+
+    static const char* PATH;    // 保留路径，返回 Prometheus 文本格式
+
+public:
+    static void inc(COUNTER c, uint64_t n = 1);
+    static void observe(HISTOGRAM h, uint64_t us);
+    static void status(int code);
+
+    // 注册在渲染时才取值的指标（连接数、队列长度等），type 为 counter 或 gauge
+    static void addCollector(const string& name, const string& type, const string& help, std::function<double()> fn);
+
+    static string render();
+
+    static uint64_t nowUs()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+public:
+    static const int SUB_BUCKETS = 8;                       // 每个 2 的幂区间的子桶数
+    static const int BUCKET_NUM = 16 + (64 - 4) * SUB_BUCKETS;
+    static const int STATUS_NUM = 600;                      // 状态码直接作下标
+
+    static int bucketOf(uint64_t v);
+    static uint64_t bucketUpper(int idx);
+
+private:
+    /* 单写者计数器：只有所属线程写，读者 relaxed 读 */
+    struct alignas(64) PaddedCounter
+    {
+        std::atomic<uint64_t> value{0};
+
+        void add(uint64_t n)
+        {
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    };
+
+    struct Histogram
+    {
+        PaddedCounter count;
+        PaddedCounter sum;
+        std::atomic<uint64_t> buckets[BUCKET_NUM] = {};
+    };
+
+    struct alignas(64) ThreadBlock
+    {
+        PaddedCounter counters[COUNTER_NUM];
+        Histogram hists[HISTOGRAM_NUM];
+        std::atomic<uint64_t> status[STATUS_NUM] = {};
+        bool inUse = false;
+    };
+
+    struct Collector
+    {
+        string name;
+        string type;
+        string help;
+        std::function<double()> fn;
+    };
+
+    struct Registry
+    {
+        std::mutex mtx;
+        std::vector<ThreadBlock*> blocks;       // 所有线程块（含空闲可复用的）
+        ThreadBlock retired;                    // 已退出线程的累计值
+        std::vector<Collector> collectors;
+    };
+
+    struct LocalHolder
+    {
+        ThreadBlock* block = nullptr;
+        bool destroyed = false;     // 线程退出时已归还块，之后析构的 thread_local 不再记录
+        ~LocalHolder();
+    };
+
+    static thread_local LocalHolder t_holder;
+
+    static Registry& registry();
+    static ThreadBlock* local();     // 本线程已归还块时返回 nullptr
+    static void bump(std::atomic<uint64_t>& v, uint64_t n = 1)
+    {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static void mergeInto(ThreadBlock& dst, const ThreadBlock& src);
+    static void reset(ThreadBlock& b);
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "trace.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <iostream>
+
+const char* Trace::PATH = "/debug/trace";
+
+int Trace::s_sampleRate = 0;
+size_t Trace::s_ringSize = 4096;
+std::atomic<uint32_t> Trace::s_nextId{1};
+thread_local Trace::LocalHolder Trace::t_holder;
+thread_local uint32_t Trace::t_counter = 0;
+
+namespace
+{
+
+const char* PHASE_NAME[] =
+{
+    "dispatch_read",
+    "dispatch_write",
+    "queue",
+    "read",
+    "process",
+    "parse",
+    "verify",
+    "response",
+    "write",
+};
+
+}
+
+Trace::Registry& Trace::registry()
+{
+    // 不析构：线程退出时的 LocalHolder 可能晚于静态对象析构
+    static Registry* reg = new Registry;
+    return *reg;
+}
+
+Trace::LocalHolder::~LocalHolder()
+{
+    if(ring == nullptr) return;
+
+    std::lock_guard<std::mutex> locker(registry().mtx);
+    ring->inUse = false;
+}
+
+void Trace::init()
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "Trace use default configuration..." << std::endl;
+#endif
+    }
+
+    s_sampleRate = std::max(s_sampleRate, 0);
+    s_ringSize = std::max<size_t>(s_ringSize, 64);
+}
+
+bool Trace::loadConfigFile()
+{
+    string configPath = getConfigPath() + "trace.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << configPath << std::endl;
+#endif
+    std::ifstream ifs(configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "samplerate")
+            {
+                s_sampleRate = std::stoi(value);
+            }
+            else if(key == "ringsize")
+            {
+                s_ringSize = std::stoul(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+uint32_t Trace::sample()
+{
+    if(++t_counter < static_cast<uint32_t>(s_sampleRate)) return 0;
+
+    t_counter = 0;
+    uint32_t id = s_nextId.fetch_add(1, std::memory_order_relaxed);
+    // 回绕时跳过 0
+    return id ? id : s_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+Trace::Ring* Trace::local()
+{
+    if(t_holder.ring) return t_holder.ring;
+
+    int tid = static_cast<int>(syscall(SYS_gettid));
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> locker(reg.mtx);
+
+    Ring* ring = nullptr;
+    for(Ring* r : reg.rings)
+    {
+        if(!r->inUse)
+        {
+            ring = r;
+            break;
+        }
+    }
+    if(ring == nullptr)
+    {
+        ring = new Ring(s_ringSize);
+        reg.rings.push_back(ring);
+    }
+
+    ring->inUse = true;
+    ring->tid.store(tid, std::memory_order_relaxed);
+    ring->name = "worker";
+    t_holder.ring = ring;
+    return ring;
+}
+
+void Trace::setThreadName(const char* name)
+{
+    Ring* ring = local();
+    std::lock_guard<std::mutex> locker(registry().mtx);
+    ring->name = name;
+}
+
+void Trace::record(uint32_t id, PHASE phase, uint64_t startUs, uint64_t endUs)
+{
+    Ring* ring = local();
+    Span& span = ring->spans[ring->head++ % ring->spans.size()];
+
+    uint64_t seq = span.seq.load(std::memory_order_relaxed);
+    span.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    span.id.store(id, std::memory_order_relaxed);
+    span.phase.store(phase, std::memory_order_relaxed);
+    span.startUs.store(startUs, std::memory_order_relaxed);
+    span.endUs.store(endUs, std::memory_order_relaxed);
+
+    span.seq.store(seq + 2, std::memory_order_release);
+}
+
+string Trace::dump()
+{
+    string out;
+    out.reserve(1 << 16);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    char buf[256];
+    bool first = true;
+    auto append = [&](int n)
+    {
+        if(!first) out += ',';
+        out.append(buf, n);
+        first = false;
+    };
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> locker(reg.mtx);
+
+    for(Ring* ring : reg.rings)
+    {
+        int tid = ring->tid.load(std::memory_order_relaxed);
+        append(snprintf(buf, sizeof(buf),
+            "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            tid, ring->name.c_str()));
+
+        for(Span& span : ring->spans)
+        {
+            uint64_t seq = span.seq.load(std::memory_order_acquire);
+            if(seq == 0 || (seq & 1)) continue;
+
+            uint32_t id = span.id.load(std::memory_order_relaxed);
+            uint32_t phase = span.phase.load(std::memory_order_relaxed);
+            uint64_t start = span.startUs.load(std::memory_order_relaxed);
+            uint64_t end = span.endUs.load(std::memory_order_relaxed);
+
+            // 读取期间被改写则丢弃
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(span.seq.load(std::memory_order_relaxed) != seq || phase >= PHASE_NUM) continue;
+
+            uint64_t dur = end > start ? end - start : 0;
+            if(phase == QUEUE)
+            {
+                // 排队跨越反应堆和工作线程，用异步事件单独成轨
+                append(snprintf(buf, sizeof(buf),
+                    "{\"ph\":\"b\",\"cat\":\"queue\",\"name\":\"queue\",\"id\":%u,\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                    id, (unsigned long long)start, tid));
+                append(snprintf(buf, sizeof(buf),
+                    "{\"ph\":\"e\",\"cat\":\"queue\",\"name\":\"queue\",\"id\":%u,\"ts\":%llu,\"pid\":1,\"tid\":%d}",
+                    id, (unsigned long long)end, tid));
+            }
+            else
+            {
+                append(snprintf(buf, sizeof(buf),
+                    "{\"ph\":\"X\",\"cat\":\"http\",\"name\":\"%s\",\"ts\":%llu,\"dur\":%llu,\"pid\":1,\"tid\":%d,\"args\":{\"req\":%u}}",
+                    PHASE_NAME[phase], (unsigned long long)start, (unsigned long long)dur, tid, id));
+            }
+        }
+    }
+
+    out += "]}";
+    return out;
+}
@@ -0,0 +1,125 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+
+#include "metrics.h"
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  采样式请求追踪
+ *  - 反应堆在 dealRead 处按 1/sampleRate 采样，给连接分配追踪 id（0 表示不追踪）
+ *  - 各阶段用 TraceScope 记录 [开始, 结束)，未采样时只有一次可预测的分支
+ *  - 记录写入每线程的定长环（覆盖最旧的），读取时用每槽序号丢弃被改写的记录
+ *  - Trace::dump() 导出 Chrome trace-event JSON（chrome://tracing、Perfetto 可直接打开）
+ */
+class Trace
+{
+public:
+    enum PHASE
+    {
+        DISPATCH_READ = 0,      // 反应堆处理读事件（dealRead）
+        DISPATCH_WRITE,         // 反应堆处理写事件（dealWrite）
+        QUEUE,                  // 任务在线程池队列中等待
+        READ,                   // onRead：readv 读入
+        PROCESS,                // onProcess：解析 + 生成响应
+        PARSE,                  // HttpConn::process 中的请求解析
+        VERIFY,                 // userVerify：登录/注册校验（含数据库）
+        RESPONSE,               // makeResponse
+        WRITE,                  // onWrite：writev 写出
+        PHASE_NUM,
+    };
+
+    static const char* PATH;    // 保留路径，返回 Chrome trace JSON
+
+public:
+    static void init();
+
+    // 反应堆调用：返回新的追踪 id，未被采样返回 0
+    static bool active() { return s_sampleRate != 0; }
+    static uint32_t sample();
+
+    static void record(uint32_t id, PHASE phase, uint64_t startUs, uint64_t endUs);
+    static void setThreadName(const char* name);
+
+    static string dump();
+
+private:
+    /* 单写者槽位，seqlock：写前序号置奇数，写完置偶数 */
+    struct Span
+    {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint32_t> id{0};
+        std::atomic<uint32_t> phase{0};
+        std::atomic<uint64_t> startUs{0};
+        std::atomic<uint64_t> endUs{0};
+    };
+
+    struct Ring
+    {
+        std::atomic<int> tid{0};
+        string name;                        // 受 Registry::mtx 保护
+        uint64_t head = 0;                  // 仅所属线程写
+        std::vector<Span> spans;
+        bool inUse = false;
+
+        explicit Ring(size_t n) : spans(n) {}
+    };
+
+    struct Registry
+    {
+        std::mutex mtx;
+        std::vector<Ring*> rings;           // 线程退出后保留以便事后导出，新线程优先复用
+    };
+
+    struct LocalHolder
+    {
+        Ring* ring = nullptr;
+        ~LocalHolder();
+    };
+
+    static Registry& registry();
+    static Ring* local();
+    static bool loadConfigFile();
+
+    static int s_sampleRate;
+    static size_t s_ringSize;
+    static std::atomic<uint32_t> s_nextId;
+    static thread_local LocalHolder t_holder;
+    static thread_local uint32_t t_counter;
+};
+
+/* 作用域计时：id 为 0 时构造和析构都只有一次可预测的分支 */
+class TraceScope
+{
+public:
+    TraceScope(uint32_t id, Trace::PHASE phase) : m_id(id), m_phase(phase), m_start(0)
+    {
+        if(__builtin_expect(m_id != 0, 0)) m_start = Metrics::nowUs();
+    }
+
+    ~TraceScope()
+    {
+        if(__builtin_expect(m_id != 0, 0)) Trace::record(m_id, m_phase, m_start, Metrics::nowUs());
+    }
+
+    uint64_t startUs() const { return m_start; }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    uint32_t m_id;
+    Trace::PHASE m_phase;
+    uint64_t m_start;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "asyncMysqlConn.h"
+
+AsyncMysqlConnection::AsyncMysqlConnection()
+:m_mysql(nullptr), m_watcher(nullptr), m_timeoutMs(3000), m_broken(false), m_port(0)
+{
+}
+
+AsyncMysqlConnection::~AsyncMysqlConnection()
+{
+    closeHandle();
+}
+
+void AsyncMysqlConnection::initHandle()
+{
+    m_mysql = mysql_init(nullptr);
+    assert(m_mysql);
+    mysql_options(m_mysql, MYSQL_OPT_NONBLOCK, 0);
+
+    // 设置读写超时后，非阻塞接口的等待状态会带上 MYSQL_WAIT_TIMEOUT 和剩余时间
+    if(m_timeoutMs > 0)
+    {
+        unsigned int sec = (m_timeoutMs + 999) / 1000;
+        mysql_options(m_mysql, MYSQL_OPT_CONNECT_TIMEOUT, &sec);
+        mysql_options(m_mysql, MYSQL_OPT_READ_TIMEOUT, &sec);
+        mysql_options(m_mysql, MYSQL_OPT_WRITE_TIMEOUT, &sec);
+    }
+}
+
+void AsyncMysqlConnection::closeHandle()
+{
+    if(m_mysql == nullptr)
+    {
+        return;
+    }
+
+    // 旧连接上的预处理语句全部失效
+    for(auto& it : m_stmts)
+    {
+        mysql_stmt_close(it.second.stmt);
+    }
+    m_stmts.clear();
+
+    // 先取消监听再关闭 socket，否则 fd 被新连接复用后事件会被当作数据库事件吞掉
+    int fd = mysql_get_socket(m_mysql);
+    if(m_watcher != nullptr && fd >= 0)
+    {
+        m_watcher->unwatch(fd);
+    }
+    mysql_close(m_mysql);
+    m_mysql = nullptr;
+}
+
+bool AsyncMysqlConnection::connect(const string& ip, const string& user, const string& passwd, const unsigned int port, const string& dbname)
+{
+    m_ip = ip;
+    m_user = user;
+    m_passwd = passwd;
+    m_port = port;
+    m_dbname = dbname;
+
+    closeHandle();
+    initHandle();
+
+    // 启动阶段同步建立连接，之后的查询都走非阻塞接口
+    MYSQL* p = mysql_real_connect(m_mysql, ip.c_str(), user.c_str(), passwd.c_str(), dbname.c_str(), port, nullptr, 0);
+    m_broken = p == nullptr;
+
+    return p != nullptr;
+}
+
+bool AsyncMysqlConnection::reconnect()
+{
+    bool ok = connect(m_ip, m_user, m_passwd, m_port, m_dbname);
+    LOG_WARN("async mysql reconnect %s:%u %s", m_ip.c_str(), m_port, ok ? "ok" : mysql_error(m_mysql));
+    return ok;
+}
+
+string AsyncMysqlConnection::escape(const string& str)
+{
+    string out(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(m_mysql, &out[0], str.c_str(), str.size());
+    out.resize(len);
+    return out;
+}
+
+bool AsyncMysqlConnection::WaitIo::await_ready() const noexcept
+{
+    // 只剩超时等待时不挂起，直接以超时事件继续
+    return (status & (MYSQL_WAIT_READ | MYSQL_WAIT_WRITE | MYSQL_WAIT_EXCEPT)) == 0;
+}
+
+void AsyncMysqlConnection::WaitIo::await_suspend(std::coroutine_handle<> h)
+{
+    uint32_t events = 0;
+    if(status & MYSQL_WAIT_READ) events |= EPOLLIN;
+    if(status & MYSQL_WAIT_WRITE) events |= EPOLLOUT;
+    if(status & MYSQL_WAIT_EXCEPT) events |= EPOLLPRI;
+
+    // 库给出了剩余时间就按它等待，否则按连接的超时兜底，数据库无响应时协程不会一直挂起
+    int timeoutMs = conn->m_timeoutMs;
+    if(status & MYSQL_WAIT_TIMEOUT)
+    {
+        timeoutMs = static_cast<int>(mysql_get_timeout_value_ms(conn->m_mysql));
+    }
+
+    conn->m_watcher->watch(mysql_get_socket(conn->m_mysql), events, h, &revents, timeoutMs);
+}
+
+int AsyncMysqlConnection::WaitIo::await_resume() const noexcept
+{
+    if(revents == 0) return MYSQL_WAIT_TIMEOUT;
+
+    int ready = 0;
+    if(revents & (EPOLLIN | EPOLLHUP | EPOLLERR)) ready |= MYSQL_WAIT_READ;
+    if(revents & EPOLLOUT) ready |= MYSQL_WAIT_WRITE;
+    if(revents & EPOLLPRI) ready |= MYSQL_WAIT_EXCEPT;
+    return ready;
+}
+
+Task<bool> AsyncMysqlConnection::realQuery(const string& sql)
+{
+    assert(m_watcher);
+    int err = 0;
+    uint64_t start = Metrics::nowUs();
+
+    int status = mysql_real_query_start(&err, m_mysql, sql.c_str(), sql.size());
+    while(status)
+    {
+        int ready = co_await WaitIo{this, status};
+        if(ready == MYSQL_WAIT_TIMEOUT)
+        {
+            m_broken = true;
+        }
+        status = mysql_real_query_cont(&err, m_mysql, ready);
+    }
+
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+    if(err != 0)
+    {
+        checkError(mysql_errno(m_mysql), mysql_error(m_mysql));
+    }
+    co_return err == 0;
+}
+
+void AsyncMysqlConnection::checkError(unsigned int code, const char* msg)
+{
+    if(code == CR_SERVER_GONE_ERROR || code == CR_SERVER_LOST)
+    {
+        m_broken = true;
+    }
+    LOG_WARN("async mysql query failed: %s", msg);
+}
+
+Task<MYSQL_RES*> AsyncMysqlConnection::query(string sql)
+{
+    if(!co_await realQuery(sql))
+    {
+        co_return nullptr;
+    }
+
+    // store_result 把结果集全部读入内存，之后 mysql_fetch_row 不会再阻塞
+    MYSQL_RES* res = nullptr;
+    int status = mysql_store_result_start(&res, m_mysql);
+    while(status)
+    {
+        int ready = co_await WaitIo{this, status};
+        if(ready == MYSQL_WAIT_TIMEOUT)
+        {
+            m_broken = true;
+        }
+        status = mysql_store_result_cont(&res, m_mysql, ready);
+    }
+
+    co_return res;
+}
+
+Task<bool> AsyncMysqlConnection::update(string sql)
+{
+    co_return co_await realQuery(sql);
+}
+
+Task<MysqlConnection::PreparedStmt*> AsyncMysqlConnection::prepare(MysqlConnection::StmtId id)
+{
+    auto it = m_stmts.find(id);
+    if(it != m_stmts.end())
+    {
+        co_return &it->second;
+    }
+
+    const string& sql = MysqlConnection::stmtSql(id);
+    MYSQL_STMT* stmt = mysql_stmt_init(m_mysql);
+    if(stmt == nullptr)
+    {
+        co_return nullptr;
+    }
+
+    int ret = 0;
+    int status = mysql_stmt_prepare_start(&ret, stmt, sql.c_str(), sql.size());
+    while(status)
+    {
+        int ready = co_await WaitIo{this, status};
+        if(ready == MYSQL_WAIT_TIMEOUT)
+        {
+            m_broken = true;
+        }
+        status = mysql_stmt_prepare_cont(&ret, stmt, ready);
+    }
+
+    if(ret != 0)
+    {
+        checkError(mysql_stmt_errno(stmt), mysql_stmt_error(stmt));
+        mysql_stmt_close(stmt);
+        co_return nullptr;
+    }
+
+    MysqlConnection::PreparedStmt& ps = m_stmts[id];
+    ps.stmt = stmt;
+    ps.initResults();
+    co_return &ps;
+}
+
+Task<bool> AsyncMysqlConnection::executeOnce(MysqlConnection::PreparedStmt* ps)
+{
+    int ret = 0;
+    int status = mysql_stmt_execute_start(&ret, ps->stmt);
+    while(status)
+    {
+        int ready = co_await WaitIo{this, status};
+        if(ready == MYSQL_WAIT_TIMEOUT)
+        {
+            m_broken = true;
+        }
+        status = mysql_stmt_execute_cont(&ret, ps->stmt, ready);
+    }
+
+    if(ret == 0 && !ps->results.empty())
+    {
+        // 结果集全部读入内存，之后 mysql_stmt_fetch 不会再访问网络
+        ret = mysql_stmt_bind_result(ps->stmt, ps->results.data());
+        if(ret == 0)
+        {
+            status = mysql_stmt_store_result_start(&ret, ps->stmt);
+            while(status)
+            {
+                int ready = co_await WaitIo{this, status};
+                if(ready == MYSQL_WAIT_TIMEOUT)
+                {
+                    m_broken = true;
+                }
+                status = mysql_stmt_store_result_cont(&ret, ps->stmt, ready);
+            }
+        }
+    }
+
+    if(ret != 0)
+    {
+        checkError(mysql_stmt_errno(ps->stmt), mysql_stmt_error(ps->stmt));
+    }
+    co_return ret == 0;
+}
+
+Task<bool> AsyncMysqlConnection::execute(MysqlConnection::StmtId id, std::vector<string> params)
+{
+    assert(m_watcher);
+    uint64_t start = Metrics::nowUs();
+
+    MysqlConnection::PreparedStmt* ps = co_await prepare(id);
+    bool ok = ps != nullptr && ps->bindParams(params) && co_await executeOnce(ps);
+
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+    co_return ok;
+}
+
+bool AsyncMysqlConnection::fetch(MysqlConnection::StmtId id, std::vector<string>& row)
+{
+    auto it = m_stmts.find(id);
+    if(it == m_stmts.end())
+    {
+        return false;
+    }
+
+    return it->second.fetchRow(row);
+}
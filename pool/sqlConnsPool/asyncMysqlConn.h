@@ -0,0 +1,106 @@
+#ifndef ASYNCMYSQLCONN_H
+#define ASYNCMYSQLCONN_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <coroutine>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include <mysql/errmsg.h>
+#include <sys/epoll.h>
+#include <assert.h>
+
+#include "mysqlConn.h"
+#include "../../utils/coTask.h"
+#include "../../metrics/metrics.h"
+#include "../../log/log.h"
+
+using std::string;
+
+/**
+ *  IO 事件监听接口，由反应堆（Webserver）实现
+ *  watch  : 监听 fd 上的 events，就绪后把就绪事件写入 revents 并恢复协程；
+ *           timeoutMs > 0 时到期仍未就绪则以 revents = 0 恢复
+ *  unwatch: 连接关闭前取消监听，fd 被复用后不会再当作数据库连接
+ *  post   : 把协程投递到工作线程恢复执行
+ */
+class IoWatcher
+{
+public:
+    virtual ~IoWatcher() = default;
+
+    virtual void watch(int fd, uint32_t events, std::coroutine_handle<> h, uint32_t* revents, int timeoutMs) = 0;
+    virtual void unwatch(int fd) = 0;
+    virtual void post(std::coroutine_handle<> h) = 0;
+};
+
+
+/**
+ *  基于 MariaDB 非阻塞 API 的数据库连接
+ *  查询时协程挂起，连接的 socket 交给反应堆的 Epoller 监听
+ */
+class AsyncMysqlConnection
+{
+public:
+    AsyncMysqlConnection();
+    ~AsyncMysqlConnection();
+
+    AsyncMysqlConnection(const AsyncMysqlConnection&) = delete;
+    AsyncMysqlConnection& operator=(const AsyncMysqlConnection&) = delete;
+
+    bool connect(const string& ip, const string& user, const string& passwd, const unsigned int port, const string& dbname);
+    bool reconnect();
+    void setWatcher(IoWatcher* watcher) { m_watcher = watcher; }
+    /* 查询中每次等待 socket 的超时（毫秒），需在 connect 之前设置 */
+    void setTimeout(int ms) { m_timeoutMs = ms; }
+    /* 等待超时或连接断开后不能再用，由连接池重连或丢弃 */
+    bool broken() const { return m_broken; }
+
+    // 执行 SQL，返回完整缓存的结果集（调用者负责 mysql_free_result）；失败或无结果集返回 nullptr
+    Task<MYSQL_RES*> query(string sql);
+    Task<bool> update(string sql);
+
+    /* 预处理语句：与 MysqlConnection 共用编号和 SQL，按编号缓存在本连接上，重连后重新预处理
+     * execute 完成时结果集已全部读入内存，之后 fetch 不会阻塞 */
+    Task<bool> execute(MysqlConnection::StmtId id, std::vector<string> params);
+    bool fetch(MysqlConnection::StmtId id, std::vector<string>& row);
+
+    string escape(const string& str);
+
+private:
+    /* 等待 mysql 状态对应的 socket 事件 */
+    struct WaitIo
+    {
+        AsyncMysqlConnection* conn;
+        int status;
+        uint32_t revents = 0;
+
+        bool await_ready() const noexcept;
+        void await_suspend(std::coroutine_handle<> h);
+        int await_resume() const noexcept;
+    };
+
+    Task<bool> realQuery(const string& sql);
+    Task<MysqlConnection::PreparedStmt*> prepare(MysqlConnection::StmtId id);
+    Task<bool> executeOnce(MysqlConnection::PreparedStmt* ps);
+    void checkError(unsigned int code, const char* msg);
+    void initHandle();
+    void closeHandle();
+
+private:
+    MYSQL* m_mysql;
+    IoWatcher* m_watcher;
+    int m_timeoutMs;
+    bool m_broken;
+
+    string m_ip;
+    string m_user;
+    string m_passwd;
+    string m_dbname;
+    unsigned int m_port;
+
+    std::unordered_map<int, MysqlConnection::PreparedStmt> m_stmts;     // 预处理语句缓存（编号 -> 语句）
+};
+
+#endif
@@ -1,12 +1,52 @@
 #include "dbConnsPool.h"
 
 
+thread_local DbConnsPool::LocalSlot DbConnsPool::t_slot;
+
+DbConnsPool::LocalSlot::~LocalSlot()
+{
+    if(pool == nullptr)
+    {
+        return;
+    }
+
+    MysqlConnection* p;
+    {
+        std::lock_guard<mutex> locker(pool->m_slotMtx);
+        pool->m_slots.erase(std::remove(pool->m_slots.begin(), pool->m_slots.end(), this), pool->m_slots.end());
+        p = conn.exchange(nullptr);
+    }
+
+    // 线程退出时把缓存的连接交还共享队列
+    if(p)
+    {
+        if(pool->m_isRunning)
+        {
+            pool->pushShared(p);
+        }
+        else
+        {
+            delete p;
+            --pool->m_connCnt;
+        }
+    }
+}
+
 DbConnsPool::~DbConnsPool()
 {
-    m_isRunning = false;
+    close();
+}
+
+void DbConnsPool::close()
+{
+    {
+        std::lock_guard<mutex> locker(m_waitMtx);
+        m_isRunning = false;
+    }
 
     // 唤醒所有等待的生产者线程和扫描线程
     m_notEmpty.notify_all();
+    m_needConn.notify_all();
 
     if(m_produceThread.joinable())
     {
@@ -18,15 +58,27 @@ DbConnsPool::~DbConnsPool()
         m_scannerThread.join();
     }
 
-    std::lock_guard<mutex> locker(m_queueMtx);
     MysqlConnection* conn = nullptr;
-    while(!m_connQueue.empty())
+    while(m_connQueue && m_connQueue->tryPop(conn))
+    {
+        delete conn;
+        --m_connCnt;
+    }
+
+    while((conn = stealSlot()) != nullptr)
     {
-        conn = m_connQueue.front();
-        m_connQueue.pop();
         delete conn;
+        --m_connCnt;
     }
-    m_connCnt = 0;
+
+    std::lock_guard<mutex> locker(m_asyncMtx);
+    for(AsyncMysqlConnection* p : m_asyncConns)
+    {
+        delete p;
+    }
+    m_asyncConns.clear();
+    m_asyncIdle.clear();
+    m_asyncBroken.clear();
 
 #ifdef DEBUG
     std::cout << "ConnectionsPool is clsoed..." << std::endl;
@@ -107,6 +159,18 @@ bool DbConnsPool::loadConfigFile()
             {
                 m_connTimeout = std::stoi(value);
             }
+            else if(key == "asyncmode")
+            {
+                m_asyncMode = std::stoi(value) != 0;
+            }
+            else if(key == "asyncsize")
+            {
+                m_asyncSize = std::stoi(value);
+            }
+            else if(key == "asynctimeout")
+            {
+                m_asyncTimeout = std::stoi(value);
+            }
             else
             {
                 continue;
@@ -144,20 +208,12 @@ DbConnsPool::DbConnsPool()
     }
 
     m_isRunning = true;
+    m_connQueue.reset(new MpmcQueue<MysqlConnection*>(std::max(m_maxSize, m_minSize)));
 
-    for(int i = 0; i < m_minSize; ++i)
+    // 并行建立 minSize 个初始连接
+    if(!warmUp())
     {
-        MysqlConnection* conn = new MysqlConnection;
-        if(conn->connect(m_ip, m_user, m_passwd, m_port, m_dbname))
-        {
-            conn->refreshAliveTime();
-            m_connQueue.push(conn);
-            ++m_connCnt;
-        }
-        else
-        {
-            return;
-        }
+        return;
     }
 
     m_produceThread = std::thread(std::bind(&DbConnsPool::produceConnTask, this));
@@ -169,104 +225,395 @@ DbConnsPool::DbConnsPool()
 
 }
 
-void DbConnsPool::produceConnTask()
+bool DbConnsPool::warmUp()
 {
-    while(m_isRunning)
+    std::vector<std::thread> threads;
+    for(int i = 0; i < m_minSize; ++i)
+    {
+        threads.emplace_back([this]{
+            // 连接的客户端库缓冲区在建立连接的线程上首次写入
+            CpuAffinity::getInstance()->pin(CpuAffinity::DB);
+            MysqlConnection* conn = createConn();
+            if(conn)
+            {
+                pushShared(conn);
+            }
+        });
+    }
+
+    for(std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    return m_connCnt >= m_minSize;
+}
+
+MysqlConnection* DbConnsPool::createConn()
+{
+    MysqlConnection* conn = new MysqlConnection;
+    if(!conn->connect(m_ip, m_user, m_passwd, m_port, m_dbname))
+    {
+        delete conn;
+        return nullptr;
+    }
+
+    conn->refreshAliveTime();
+    ++m_connCnt;
+    return conn;
+}
+
+void DbConnsPool::pushShared(MysqlConnection* conn)
+{
+    if(!m_connQueue->tryPush(conn))
     {
-        std::unique_lock<mutex> locker(m_queueMtx);
+        // 队列容量不小于 maxSize，正常不会走到这里
+        delete conn;
+        --m_connCnt;
+        return;
+    }
 
-        while(!m_connQueue.empty() && m_isRunning)
+    // 与 waitConnection 中的 ++m_waiters 配对，避免丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_waiters.load() > 0)
+    {
+        std::lock_guard<mutex> locker(m_waitMtx);
+        m_notEmpty.notify_one();
+    }
+}
+
+void DbConnsPool::release(MysqlConnection* conn)
+{
+    conn->refreshAliveTime();
+
+    if(!m_isRunning)
+    {
+        delete conn;
+        --m_connCnt;
+        return;
+    }
+
+    // 没有其他线程在等待时，留在本线程下次直接复用
+    if(m_waiters.load() == 0)
+    {
+        if(t_slot.pool == nullptr)
         {
-            m_notEmpty.wait(locker);        // 队列不空，生产者线程进入等待状态
+            std::lock_guard<mutex> locker(m_slotMtx);
+            t_slot.pool = this;
+            m_slots.push_back(&t_slot);
         }
 
-        if(!m_isRunning) break;
-
-        // 队列空了，创建新的连接
-        if(m_connCnt < m_maxSize)
+        MysqlConnection* empty = nullptr;
+        if(t_slot.pool == this && t_slot.conn.compare_exchange_strong(empty, conn))
         {
-            MysqlConnection* conn = new MysqlConnection;
-            if(conn->connect(m_ip, m_user, m_passwd, m_port, m_dbname))
-            {
-                conn->refreshAliveTime();
-                m_connQueue.push(conn);
-                ++m_connCnt;
-                m_notEmpty.notify_one();
-            }
-            else
+            // 与 waitConnection 中先 ++m_waiters 再 stealSlot 配对：
+            // 放入后又出现了等待者，且连接还没被偷走，改放共享队列
+            if(m_waiters.load() == 0 || (conn = t_slot.conn.exchange(nullptr)) == nullptr)
             {
                 return;
             }
-
         }
     }
+
+    pushShared(conn);
 }
 
-shared_ptr<MysqlConnection> DbConnsPool::getConnection()
+MysqlConnection* DbConnsPool::stealSlot()
 {
-    std::unique_lock<mutex> locker(m_queueMtx);
-
+    std::lock_guard<mutex> locker(m_slotMtx);
+    for(LocalSlot* slot : m_slots)
+    {
+        MysqlConnection* p = slot->conn.exchange(nullptr);
+        if(p)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
 
-    // 连接池空闲连接现在为空
-    while(m_connQueue.empty())
+void DbConnsPool::expireSlots()
+{
+    // 先取出再检查空闲时间，避免与所属线程同时访问连接；没过期的放回原槽，槽已被占用就放共享队列
+    std::vector<MysqlConnection*> expired;
+    std::vector<MysqlConnection*> spill;
     {
-        if(std::cv_status::timeout == m_notEmpty.wait_for(locker, std::chrono::milliseconds(m_connTimeout)))
+        std::lock_guard<mutex> locker(m_slotMtx);
+        for(LocalSlot* slot : m_slots)
         {
-            if(m_connQueue.empty())
+            MysqlConnection* p = slot->conn.exchange(nullptr);
+            if(p == nullptr)
             {
-#ifdef DEBUG
-                std::cout << "获取空闲连接超时了......" << std::endl;
-#endif
-                return nullptr;
+                continue;
+            }
+
+            if(m_connCnt - static_cast<int>(expired.size()) > m_minSize && p->getAliveTime() >= (m_maxIdleTime * 1000LL))
+            {
+                expired.push_back(p);
+                continue;
+            }
+
+            MysqlConnection* empty = nullptr;
+            if(!slot->conn.compare_exchange_strong(empty, p))
+            {
+                spill.push_back(p);
             }
         }
     }
 
-    // 连接池不为空
-    shared_ptr<MysqlConnection> sp(m_connQueue.front(), [this](MysqlConnection* conn){
-        std::unique_lock<mutex> locker(m_queueMtx);
-        if(m_isRunning)
+    for(MysqlConnection* p : expired)
+    {
+        --m_connCnt;
+        delete p;
+    }
+    for(MysqlConnection* p : spill)
+    {
+        pushShared(p);
+    }
+}
+
+void DbConnsPool::produceConnTask()
+{
+    CpuAffinity::getInstance()->pin(CpuAffinity::DB);
+    while(m_isRunning)
+    {
         {
-            m_connQueue.push(conn);
+            std::unique_lock<mutex> locker(m_waitMtx);
+            // 有线程在等待连接时才需要生产；断开的异步连接也在这里重连
+            m_needConn.wait(locker, [this]{ return !m_isRunning || m_waiters.load() > 0 || !m_asyncBroken.empty(); });
+        }
+
+        if(!m_isRunning) break;
+
+        reconnectAsync();
+        if(m_waiters.load() == 0) continue;
+
+        // 共享队列空了，且没有超过上限，创建新的连接
+        MysqlConnection* conn = nullptr;
+        if(m_connQueue->sizeApprox() == 0 && m_connCnt < m_maxSize)
+        {
+            conn = createConn();
+        }
+
+        if(conn)
+        {
+            pushShared(conn);
         }
         else
         {
-            delete conn;
+            // 已达上限或连接失败，稍等再检查，避免空转
+            std::unique_lock<mutex> locker(m_waitMtx);
+            m_needConn.wait_for(locker, std::chrono::milliseconds(10), [this]{ return !m_isRunning; });
         }
-    });
+    }
+}
 
-    m_connQueue.pop();
+shared_ptr<MysqlConnection> DbConnsPool::getConnection()
+{
+    MysqlConnection* conn = nullptr;
+    uint64_t start = Metrics::nowUs();
 
-    // 谁消费了最后一个连接，谁去唤醒生产者线程
-    if(m_connQueue.empty())
+    if(t_slot.pool == this && (conn = t_slot.conn.exchange(nullptr)) != nullptr)
+    {
+        // 1.本线程缓存的连接
+    }
+    else if(!m_connQueue || !m_connQueue->tryPop(conn))
     {
-        m_notEmpty.notify_all();
+        // 2.共享队列也空了，等待归还或新建
+        conn = waitConnection();
+        if(conn == nullptr)
+        {
+            return nullptr;
+        }
     }
+    Metrics::observe(Metrics::DB_WAIT, Metrics::nowUs() - start);
 
-    return sp;
+    return shared_ptr<MysqlConnection>(conn, [this](MysqlConnection* c){
+        release(c);
+    });
+}
+
+MysqlConnection* DbConnsPool::waitConnection()
+{
+    if(!m_connQueue) return nullptr;
+
+    MysqlConnection* conn = nullptr;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_connTimeout);
+
+    std::unique_lock<mutex> locker(m_waitMtx);
+    ++m_waiters;
+    m_needConn.notify_one();
 
+    // 登记等待后，其他线程不再把连接留在自己的槽里；已经留下的直接取走
+    while(!m_connQueue->tryPop(conn) && (conn = stealSlot()) == nullptr)
+    {
+        if(!m_isRunning || std::cv_status::timeout == m_notEmpty.wait_until(locker, deadline))
+        {
+            if(!m_connQueue->tryPop(conn) && (conn = stealSlot()) == nullptr)
+            {
+#ifdef DEBUG
+                std::cout << "获取空闲连接超时了......" << std::endl;
+#endif
+                LOG_WARN("wait for database connection timed out");
+                conn = nullptr;
+            }
+            break;
+        }
+    }
+
+    --m_waiters;
+    return conn;
 }
 
 void DbConnsPool::scannerConnTask()
 {
+    CpuAffinity::getInstance()->pin(CpuAffinity::DB);
     while(m_isRunning)
     {
-        std::this_thread::sleep_for(std::chrono::seconds(m_maxIdleTime));
-        std::unique_lock<mutex> locker(m_queueMtx);
+        {
+            std::unique_lock<mutex> locker(m_waitMtx);
+            m_needConn.wait_for(locker, std::chrono::seconds(m_maxIdleTime), [this]{ return !m_isRunning; });
+        }
+        if(!m_isRunning) break;
 
-        while(m_connCnt > m_minSize)
+        // 共享队列先进先出，队头空闲最久
+        size_t n = m_connQueue->sizeApprox();
+        MysqlConnection* p = nullptr;
+        for(size_t i = 0; i < n && m_connCnt > m_minSize; ++i)
         {
-            MysqlConnection* p = m_connQueue.front();
-            if(p->getAliveTime() >= (m_maxIdleTime * 1000))
+            if(!m_connQueue->tryPop(p)) break;
+
+            if(p->getAliveTime() >= (m_maxIdleTime * 1000LL))
             {
-                m_connQueue.pop();
                 --m_connCnt;
                 delete p;
             }
             else
             {
+                pushShared(p);
                 break;
             }
         }
+
+        // 各线程槽里的连接同样按空闲时间回收
+        expireSlots();
     }
-}
\ No newline at end of file
+}
+
+bool DbConnsPool::initAsync(IoWatcher* watcher)
+{
+    assert(watcher);
+    std::lock_guard<mutex> locker(m_asyncMtx);
+    m_watcher = watcher;
+
+    for(int i = 0; i < m_asyncSize; ++i)
+    {
+        AsyncMysqlConnection* conn = new AsyncMysqlConnection;
+        conn->setTimeout(m_asyncTimeout);
+        if(!conn->connect(m_ip, m_user, m_passwd, m_port, m_dbname))
+        {
+            delete conn;
+#ifdef DEBUG
+            std::cout << "async connection init failed..." << std::endl;
+#endif
+            return false;
+        }
+
+        conn->setWatcher(watcher);
+        m_asyncConns.push_back(conn);
+        m_asyncIdle.push_back(conn);
+    }
+
+    return true;
+}
+
+bool DbConnsPool::AsyncConnAwaiter::await_suspend(std::coroutine_handle<> h)
+{
+    std::lock_guard<mutex> locker(m_pool->m_asyncMtx);
+
+    // 有空闲连接或者根本没有异步连接：不挂起
+    if(!m_pool->m_asyncIdle.empty())
+    {
+        m_conn = m_pool->m_asyncIdle.back();
+        m_pool->m_asyncIdle.pop_back();
+        return false;
+    }
+    if(m_pool->m_asyncConns.empty())
+    {
+        return false;
+    }
+
+    m_pool->m_asyncWaiters.push_back({h, &m_conn});
+    return true;
+}
+
+shared_ptr<AsyncMysqlConnection> DbConnsPool::AsyncConnAwaiter::await_resume()
+{
+    if(m_conn == nullptr)
+    {
+        return nullptr;
+    }
+
+    // 归还时重连失败的连接：再交还一次（会再尝试重连），本次查询直接失败
+    if(m_conn->broken())
+    {
+        m_pool->releaseAsync(m_conn);
+        return nullptr;
+    }
+
+    DbConnsPool* pool = m_pool;
+    return shared_ptr<AsyncMysqlConnection>(m_conn, [pool](AsyncMysqlConnection* conn){
+        pool->releaseAsync(conn);
+    });
+}
+
+void DbConnsPool::releaseAsync(AsyncMysqlConnection* conn)
+{
+    // 等待超时或断开的连接上可能还有未读完的响应，不能直接交给下一个查询
+    // 重连是阻塞的，交给生产者线程完成，不占用归还连接的工作线程
+    if(conn->broken() && m_produceThread.joinable())
+    {
+        {
+            std::lock_guard<mutex> locker(m_waitMtx);
+            m_asyncBroken.push_back(conn);
+        }
+        m_needConn.notify_all();
+        return;
+    }
+
+    handAsync(conn);
+}
+
+void DbConnsPool::reconnectAsync()
+{
+    std::vector<AsyncMysqlConnection*> broken;
+    {
+        std::lock_guard<mutex> locker(m_waitMtx);
+        broken.swap(m_asyncBroken);
+    }
+
+    // 重连失败的连接仍然交出去：等待的查询立即失败，下次归还时再重连
+    for(AsyncMysqlConnection* conn : broken)
+    {
+        conn->reconnect();
+        handAsync(conn);
+    }
+}
+
+void DbConnsPool::handAsync(AsyncMysqlConnection* conn)
+{
+    std::unique_lock<mutex> locker(m_asyncMtx);
+    if(m_asyncWaiters.empty())
+    {
+        m_asyncIdle.push_back(conn);
+        return;
+    }
+
+    // 直接把连接交给排队的协程，并投递到工作线程恢复
+    AsyncWaiter waiter = m_asyncWaiters.front();
+    m_asyncWaiters.pop_front();
+    *waiter.slot = conn;
+    locker.unlock();
+
+    m_watcher->post(waiter.handle);
+}
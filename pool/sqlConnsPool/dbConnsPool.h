@@ -2,7 +2,6 @@
 #define DBCONNSPOOL_H
 
 #include <string>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <fstream>
@@ -11,15 +10,21 @@
 #include <thread>
 #include <functional>
 #include <unistd.h>
+#include <coroutine>
+#include <deque>
+#include <vector>
 #include <mysqlConn.h>
+#include <asyncMysqlConn.h>
 #include <iostream>
 #include <algorithm>
 
 #include "../utils/pathInfo.h"
+#include "../utils/cpuAffinity.h"
+#include "../utils/mpmcQueue.h"
+#include "../../metrics/metrics.h"
 
 using std::string;
 using std::mutex;
-using std::queue;
 using std::shared_ptr;
 
 class DbConnsPool
@@ -29,6 +34,28 @@ public:
     shared_ptr<MysqlConnection> getConnection();
     ~DbConnsPool();
 
+    // 停止后台线程并释放空闲连接，可重复调用
+    void close();
+
+    /* 协程异步连接 */
+    class AsyncConnAwaiter
+    {
+    public:
+        explicit AsyncConnAwaiter(DbConnsPool* pool) : m_pool(pool) {}
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h);
+        shared_ptr<AsyncMysqlConnection> await_resume();
+
+    private:
+        DbConnsPool* m_pool;
+        AsyncMysqlConnection* m_conn = nullptr;
+    };
+
+    bool isAsyncMode() const { return m_asyncMode; }
+    bool initAsync(IoWatcher* watcher);
+    AsyncConnAwaiter getAsyncConnection() { return AsyncConnAwaiter(this); }
+
 private:
     DbConnsPool();
     bool loadConfigFile();
@@ -37,6 +64,18 @@ private:
 
     void scannerConnTask();
 
+    bool warmUp();
+    MysqlConnection* createConn();
+    MysqlConnection* waitConnection();
+    void release(MysqlConnection* conn);
+    void pushShared(MysqlConnection* conn);
+    MysqlConnection* stealSlot();
+    void expireSlots();
+
+    void releaseAsync(AsyncMysqlConnection* conn);
+    void handAsync(AsyncMysqlConnection* conn);
+    void reconnectAsync();
+
 
 private:
     /* mysql 的连接信息 */
@@ -53,15 +92,50 @@ private:
     int m_connTimeout;    // 连接池获取连接的超时时间
     string m_configPath;
 
-    queue<MysqlConnection*> m_connQueue;
-    mutex m_queueMtx;
+    /**
+     *  线程亲和缓存：每个线程优先复用自己归还的连接，取放只是一次原子交换
+     *  所有槽登记在 m_slots 中，等待连接的线程和扫描线程可以从别的线程的槽里取走空闲连接
+     */
+    struct LocalSlot
+    {
+        DbConnsPool* pool = nullptr;
+        std::atomic<MysqlConnection*> conn{nullptr};
+        ~LocalSlot();
+    };
+    static thread_local LocalSlot t_slot;
+    mutex m_slotMtx;
+    std::vector<LocalSlot*> m_slots;
+
+    std::unique_ptr<MpmcQueue<MysqlConnection*>> m_connQueue;   // 无锁共享空闲连接队列
+
+    std::atomic<int> m_connCnt{0};          // 连接的总数
+    std::atomic<int> m_waiters{0};          // 正在等待空闲连接的线程数
 
-    std::atomic<int> m_connCnt;             // 连接的总数
-    std::condition_variable m_notEmpty;
+    /* 只在慢路径（等待连接/唤醒生产者）上使用 */
+    mutex m_waitMtx;
+    std::condition_variable m_notEmpty;     // 有连接归还
+    std::condition_variable m_needConn;     // 唤醒生产者线程、扫描线程
     std::atomic<bool> m_isRunning{true};
 
     std::thread m_produceThread;
     std::thread m_scannerThread;
+
+    /* 异步连接：数量固定，不够时挂起协程排队等待 */
+    struct AsyncWaiter
+    {
+        std::coroutine_handle<> handle;
+        AsyncMysqlConnection** slot;
+    };
+
+    bool m_asyncMode = false;
+    int m_asyncSize = 4;
+    int m_asyncTimeout = 3000;              // 异步查询每次等待 socket 的超时（毫秒）
+    IoWatcher* m_watcher = nullptr;
+    std::vector<AsyncMysqlConnection*> m_asyncConns;
+    std::vector<AsyncMysqlConnection*> m_asyncIdle;
+    std::deque<AsyncWaiter> m_asyncWaiters;
+    mutex m_asyncMtx;
+    std::vector<AsyncMysqlConnection*> m_asyncBroken;   // 待生产者线程重连，受 m_waitMtx 保护
 };
 
 #endif
\ No newline at end of file
@@ -1,6 +1,19 @@
 #include "mysqlConn.h"
 
+const std::unordered_map<int, string> MysqlConnection::STMT_SQL
+{
+    {STMT_SELECT_USER, "SELECT username, password FROM user WHERE username=? LIMIT 1"},
+    {STMT_INSERT_USER, "INSERT INTO user(username, password) VALUES(?, ?)"},
+};
+
+const string& MysqlConnection::stmtSql(StmtId id)
+{
+    assert(STMT_SQL.count(id));
+    return STMT_SQL.find(id)->second;
+}
+
 MysqlConnection::MysqlConnection()
+:m_port(0), m_inTxn(false)
 {
     m_mysql = mysql_init(nullptr);
     assert(m_mysql);
@@ -8,6 +21,7 @@ MysqlConnection::MysqlConnection()
 
 MysqlConnection::~MysqlConnection()
 {
+    closeStmts();
     if(m_mysql != nullptr)
     {
         mysql_close(m_mysql);
@@ -16,27 +30,282 @@ MysqlConnection::~MysqlConnection()
 
 bool MysqlConnection::connect(const string& ip, const string& user, const string& passwd, const unsigned int port, const string& dbname)
 {
+    m_ip = ip;
+    m_user = user;
+    m_passwd = passwd;
+    m_port = port;
+    m_dbname = dbname;
+
     MYSQL* p = mysql_real_connect(m_mysql, ip.c_str(), user.c_str(), passwd.c_str(), dbname.c_str(), port, nullptr, 0);
+    if(p == nullptr)
+    {
+        LOG_ERROR("mysql connect %s:%u failed: %s", ip.c_str(), port, mysql_error(m_mysql));
+    }
 
     return p != nullptr;
 }
 
+bool MysqlConnection::begin()
+{
+    m_inTxn = (mysql_autocommit(m_mysql, 0) == 0);
+    return m_inTxn;
+}
+
+bool MysqlConnection::commit()
+{
+    uint64_t start = Metrics::nowUs();
+    bool ok = (mysql_commit(m_mysql) == 0);
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+
+    mysql_autocommit(m_mysql, 1);
+    m_inTxn = false;
+    return ok;
+}
+
+void MysqlConnection::rollback()
+{
+    mysql_rollback(m_mysql);
+    mysql_autocommit(m_mysql, 1);
+    m_inTxn = false;
+}
+
 bool MysqlConnection::update(const string& sql)
 {
-    if(mysql_query(m_mysql, sql.c_str()))
+    uint64_t start = Metrics::nowUs();
+    int ret = mysql_query(m_mysql, sql.c_str());
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+
+    return ret == 0;
+}
+
+MYSQL_RES* MysqlConnection::query(const string& sql)
+{
+    uint64_t start = Metrics::nowUs();
+    int ret = mysql_query(m_mysql, sql.c_str());
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+
+    if(ret)
+    {
+        return nullptr;
+    }
+
+    return mysql_use_result(m_mysql);
+}
+
+string MysqlConnection::escape(const string& str)
+{
+    string out(str.size() * 2 + 1, '\0');
+    unsigned long len = mysql_real_escape_string(m_mysql, &out[0], str.c_str(), str.size());
+    out.resize(len);
+    return out;
+}
+
+bool MysqlConnection::isConnLost(unsigned int err)
+{
+    return err == CR_SERVER_GONE_ERROR || err == CR_SERVER_LOST;
+}
+
+void MysqlConnection::closeStmts()
+{
+    for(auto& it : m_stmts)
+    {
+        mysql_stmt_close(it.second.stmt);
+    }
+    m_stmts.clear();
+}
+
+bool MysqlConnection::reconnect()
+{
+    // 旧连接上的预处理语句全部失效
+    closeStmts();
+    mysql_close(m_mysql);
+
+    m_mysql = mysql_init(nullptr);
+    assert(m_mysql);
+
+    MYSQL* p = mysql_real_connect(m_mysql, m_ip.c_str(), m_user.c_str(), m_passwd.c_str(), m_dbname.c_str(), m_port, nullptr, 0);
+    LOG_WARN("mysql reconnect %s:%u %s", m_ip.c_str(), m_port, p ? "ok" : mysql_error(m_mysql));
+
+    return p != nullptr;
+}
+
+MysqlConnection::PreparedStmt* MysqlConnection::prepare(StmtId id, size_t rows)
+{
+    assert(rows >= 1);
+    int key = static_cast<int>(rows - 1) * STMT_NUM + id;
+    auto it = m_stmts.find(key);
+    if(it != m_stmts.end())
+    {
+        return &it->second;
+    }
+
+    string sql = stmtSql(id);
+    if(rows > 1)
+    {
+        size_t pos = sql.find("VALUES");
+        assert(pos != string::npos);
+        string tuple = sql.substr(pos + 6);
+        sql.reserve(sql.size() + (tuple.size() + 1) * (rows - 1));
+        for(size_t i = 1; i < rows; ++i)
+        {
+            sql += "," + tuple;
+        }
+    }
+
+    MYSQL_STMT* stmt = mysql_stmt_init(m_mysql);
+    if(stmt == nullptr)
+    {
+        return nullptr;
+    }
+
+    if(mysql_stmt_prepare(stmt, sql.c_str(), sql.size()))
+    {
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    PreparedStmt& ps = m_stmts[key];
+    ps.stmt = stmt;
+    ps.initResults();
+
+    return &ps;
+}
+
+void MysqlConnection::PreparedStmt::initResults()
+{
+    // 为每个结果列准备固定大小的缓冲区，超长的列在 fetch 时再单独取
+    unsigned int fieldCnt = mysql_stmt_field_count(stmt);
+    results.assign(fieldCnt, MYSQL_BIND());
+    buffers.assign(fieldCnt, std::vector<char>(COLUMN_BUFF_SIZE));
+    lengths.assign(fieldCnt, 0);
+    isNull.assign(fieldCnt, 0);
+
+    for(unsigned int i = 0; i < fieldCnt; ++i)
+    {
+        MYSQL_BIND& b = results[i];
+        b.buffer_type = MYSQL_TYPE_STRING;
+        b.buffer = buffers[i].data();
+        b.buffer_length = buffers[i].size();
+        b.length = &lengths[i];
+        b.is_null = &isNull[i];
+    }
+}
+
+bool MysqlConnection::PreparedStmt::bindParams(const std::vector<string>& values)
+{
+    assert(mysql_stmt_param_count(stmt) == values.size());
+
+    // 释放上一次未取完的结果
+    mysql_stmt_free_result(stmt);
+
+    params.assign(values.size(), MYSQL_BIND());
+    paramLens.resize(values.size());
+    for(size_t i = 0; i < values.size(); ++i)
+    {
+        paramLens[i] = values[i].size();
+        params[i].buffer_type = MYSQL_TYPE_STRING;
+        params[i].buffer = const_cast<char*>(values[i].data());
+        params[i].buffer_length = paramLens[i];
+        params[i].length = &paramLens[i];
+    }
+
+    return params.empty() || mysql_stmt_bind_param(stmt, params.data()) == 0;
+}
+
+bool MysqlConnection::PreparedStmt::fetchRow(std::vector<string>& row)
+{
+    int ret = mysql_stmt_fetch(stmt);
+    if(ret != 0 && ret != MYSQL_DATA_TRUNCATED)
     {
         return false;
     }
 
+    row.resize(results.size());
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        if(isNull[i])
+        {
+            row[i].clear();
+        }
+        else if(lengths[i] <= buffers[i].size())
+        {
+            row[i].assign(buffers[i].data(), lengths[i]);
+        }
+        else
+        {
+            // 列被截断，单独取完整数据
+            row[i].assign(lengths[i], '\0');
+            MYSQL_BIND b = MYSQL_BIND();
+            b.buffer_type = MYSQL_TYPE_STRING;
+            b.buffer = &row[i][0];
+            b.buffer_length = row[i].size();
+            mysql_stmt_fetch_column(stmt, &b, i, 0);
+        }
+    }
+
     return true;
 }
 
-MYSQL_RES* MysqlConnection::query(const string& sql)
+bool MysqlConnection::executeOnce(PreparedStmt* ps, const std::vector<string>& params)
 {
-    if(mysql_query(m_mysql, sql.c_str()))
+    assert(ps);
+    if(!ps->bindParams(params))
     {
-        return nullptr;
+        return false;
     }
 
-    return mysql_use_result(m_mysql);
-}
\ No newline at end of file
+    if(mysql_stmt_execute(ps->stmt))
+    {
+        return false;
+    }
+
+    if(ps->results.empty())
+    {
+        return true;
+    }
+
+    if(mysql_stmt_bind_result(ps->stmt, ps->results.data()))
+    {
+        return false;
+    }
+
+    return mysql_stmt_store_result(ps->stmt) == 0;
+}
+
+bool MysqlConnection::execute(StmtId id, const std::vector<string>& params, size_t rows)
+{
+    uint64_t start = Metrics::nowUs();
+    bool ok = executeRetry(id, params, rows);
+    Metrics::observe(Metrics::DB_QUERY, Metrics::nowUs() - start);
+    return ok;
+}
+
+bool MysqlConnection::executeRetry(StmtId id, const std::vector<string>& params, size_t rows)
+{
+    PreparedStmt* ps = prepare(id, rows);
+    if(ps && executeOnce(ps, params))
+    {
+        return true;
+    }
+
+    // 连接断开：重连并重新预处理，只重试一次
+    unsigned int err = ps ? mysql_stmt_errno(ps->stmt) : mysql_errno(m_mysql);
+    if(m_inTxn || !isConnLost(err) || !reconnect())
+    {
+        return false;
+    }
+
+    ps = prepare(id, rows);
+    return ps && executeOnce(ps, params);
+}
+
+bool MysqlConnection::fetch(StmtId id, std::vector<string>& row)
+{
+    auto it = m_stmts.find(id);
+    if(it == m_stmts.end())
+    {
+        return false;
+    }
+
+    return it->second.fetchRow(row);
+}
@@ -2,14 +2,52 @@
 #define MYSQLCONN_H
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
 #include <mysql/mysql.h>
-#include <ctime>
+#include <mysql/errmsg.h>
+#include <chrono>
 #include <assert.h>
 
+#include "../../metrics/metrics.h"
+#include "../../log/log.h"
+
 using std::string;
 
 class MysqlConnection
 {
+public:
+    /* 预处理语句编号，对应的 SQL 见 STMT_SQL */
+    enum StmtId
+    {
+        STMT_SELECT_USER = 0,   // 按用户名查询密码
+        STMT_INSERT_USER,       // 插入新用户
+        STMT_NUM,
+    };
+
+private:
+    using BindBool = std::remove_pointer<decltype(MYSQL_BIND::is_null)>::type;
+
+public:
+    /* 一条预处理语句及其参数、结果列绑定，同步和异步连接共用 */
+    struct PreparedStmt
+    {
+        MYSQL_STMT* stmt = nullptr;
+        std::vector<MYSQL_BIND> params;         // 参数绑定，指向 paramLens 和调用方的参数，执行完成前有效
+        std::vector<unsigned long> paramLens;
+        std::vector<MYSQL_BIND> results;        // 结果列绑定
+        std::vector<std::vector<char>> buffers; // 结果列缓冲区
+        std::vector<unsigned long> lengths;
+        std::vector<BindBool> isNull;
+
+        void initResults();
+        bool bindParams(const std::vector<string>& values);
+        bool fetchRow(std::vector<string>& row);
+    };
+
+    static const string& stmtSql(StmtId id);
+
 public:
     MysqlConnection();
     ~MysqlConnection();
@@ -20,20 +58,54 @@ public:
 
     MYSQL_RES* query(const string& sql);
 
+    string escape(const string& str);
+
+    /* 预处理语句：按编号缓存，二进制绑定参数，断线重连后自动重新预处理
+     * rows > 1 时把 VALUES 后的参数组重复 rows 次成为多行语句，每种行数单独缓存 */
+    bool execute(StmtId id, const std::vector<string>& params, size_t rows = 1);
+    bool fetch(StmtId id, std::vector<string>& row);
+
+    /* 事务：事务中断线不重连重试，否则之前的语句随断开的连接回滚，之后的语句却被自动提交 */
+    bool begin();
+    bool commit();
+    void rollback();
+
     void refreshAliveTime()
     {
-        m_aliveTime = clock();
+        m_aliveTime = std::chrono::steady_clock::now();
     }
 
-    clock_t getAliveTime() const
+    // 进入空闲状态后经过的时间，单位毫秒（单调时钟，不受 CPU 时间和系统时间调整影响）
+    long long getAliveTime() const
     {
-        return clock() - m_aliveTime;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_aliveTime).count();
     }
 
+private:
+    PreparedStmt* prepare(StmtId id, size_t rows);
+    bool executeOnce(PreparedStmt* ps, const std::vector<string>& params);
+    bool executeRetry(StmtId id, const std::vector<string>& params, size_t rows);
+    bool reconnect();
+    void closeStmts();
+
+    static bool isConnLost(unsigned int err);
 
 private:
+    static const std::unordered_map<int, string> STMT_SQL;
+    static const size_t COLUMN_BUFF_SIZE = 256;
+
     MYSQL* m_mysql;
-    clock_t m_aliveTime;    //记录进入空闲状态后的起始存活时间
+    std::chrono::steady_clock::time_point m_aliveTime;    //记录进入空闲状态后的起始存活时间
+
+    /* 重连所需的连接信息 */
+    string m_ip;
+    string m_user;
+    string m_passwd;
+    string m_dbname;
+    unsigned int m_port;
+    bool m_inTxn;
+
+    std::unordered_map<int, PreparedStmt> m_stmts;  // 预处理语句缓存（(行数 - 1) * STMT_NUM + 编号 -> 语句）
 };
 
-#endif
\ No newline at end of file
+#endif
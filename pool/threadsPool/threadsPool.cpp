@@ -43,6 +43,18 @@ bool ThreadsPool::loadConfigFile()
             {
                 m_step = std::stoi(value);
             }
+            else if(key == "maxqueue")
+            {
+                m_maxQueue = std::stoul(value);
+            }
+            else if(key == "codeltarget")
+            {
+                m_codelTarget = std::stoull(value) * 1000;
+            }
+            else if(key == "codelinterval")
+            {
+                m_codelInterval = std::stoull(value) * 1000;
+            }
             else
             {
                 continue;
@@ -65,8 +77,10 @@ bool ThreadsPool::loadConfigFile()
 
 
 ThreadsPool::ThreadsPool()
-:m_busy(0), m_alive(0),m_configPath(""),m_exitCnt(0),m_isStop(false),m_maxNum(0),m_minNum(0),m_step(0)
+:m_busy(0), m_alive(0),m_configPath(""),m_exitCnt(0),m_isStop(false),m_maxNum(0),m_minNum(0),m_step(0),
+m_taskCnt(0), m_nextQue(0), m_maxQueue(4096), m_codelTarget(5000), m_codelInterval(100000), m_firstAboveUs(0), m_overloaded(false)
 {
+    m_tasksQue.resize(CpuAffinity::getInstance()->nodeCount());
 
     #ifdef DEBUG
     std::cout << "ThreadsPool start init..." << std::endl;
@@ -117,7 +131,11 @@ ThreadsPool::~ThreadsPool()
     // 清理任务队列
     {
         std::unique_lock<std::mutex> lk(m_queueMtx);
-        while(!m_tasksQue.empty()) m_tasksQue.pop();
+        for(std::queue<TaskItem>& que : m_tasksQue)
+        {
+            while(!que.empty()) que.pop();
+        }
+        m_taskCnt = 0;
     }
 
 #ifdef DEBUG
@@ -127,22 +145,114 @@ ThreadsPool::~ThreadsPool()
 }
 
 
-bool ThreadsPool::addTask(cb_fun task)
+void ThreadsPool::pushTask(cb_fun&& task, uint64_t nowUs, int node)
+{
+    size_t idx = node >= 0 && node < static_cast<int>(m_tasksQue.size()) ? node : m_nextQue++ % m_tasksQue.size();
+    m_tasksQue[idx].push(TaskItem{std::move(task), nowUs, node});
+    ++m_taskCnt;
+}
+
+bool ThreadsPool::popTask(int node, TaskItem& item)
+{
+    if(m_taskCnt == 0)
+    {
+        return false;
+    }
+
+    // 先取本节点的队列，为空再依次取其他节点的
+    size_t n = m_tasksQue.size();
+    size_t first = node >= 0 && node < static_cast<int>(n) ? node : 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        std::queue<TaskItem>& que = m_tasksQue[(first + i) % n];
+        if(!que.empty())
+        {
+            item = std::move(que.front());
+            que.pop();
+            --m_taskCnt;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t ThreadsPool::oldestEnqueueUs() const
+{
+    uint64_t oldest = UINT64_MAX;
+    for(const std::queue<TaskItem>& que : m_tasksQue)
+    {
+        if(!que.empty())
+        {
+            oldest = std::min(oldest, que.front().enqueueUs);
+        }
+    }
+    return oldest;
+}
+
+bool ThreadsPool::addTask(cb_fun task, int node)
 {
     if(m_isStop.load()) return false;
     {
         std::lock_guard<std::mutex> lk(m_queueMtx);
-        m_tasksQue.push(std::move(task));
+        pushTask(std::move(task), Metrics::nowUs(), node);
     }
 
     m_notEmpty.notify_one();
     return true;
 }
 
+ThreadsPool::ADMIT ThreadsPool::admitTask(cb_fun task, int node)
+{
+    if(m_isStop.load()) return ADMIT_STOPPED;
+    {
+        std::lock_guard<std::mutex> lk(m_queueMtx);
+        uint64_t now = Metrics::nowUs();
+
+        // 工作线程全部卡住时没有出队，由入队侧用队首的排队时间推进状态
+        if(m_taskCnt > 0)
+        {
+            updateCodel(now - std::min(now, oldestEnqueueUs()), now, false);
+        }
+
+        if(m_overloaded.load(std::memory_order_relaxed))
+        {
+            return ADMIT_OVERLOAD;
+        }
+        if(m_maxQueue > 0 && m_taskCnt >= m_maxQueue)
+        {
+            return ADMIT_QUEUE_FULL;
+        }
+
+        pushTask(std::move(task), now, node);
+    }
+
+    m_notEmpty.notify_one();
+    return ADMIT_OK;
+}
+
+void ThreadsPool::updateCodel(uint64_t sojournUs, uint64_t nowUs, bool empty)
+{
+    if(sojournUs < m_codelTarget || empty)
+    {
+        m_firstAboveUs = 0;
+        m_overloaded.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    if(m_firstAboveUs == 0)
+    {
+        m_firstAboveUs = nowUs + m_codelInterval;
+    }
+    else if(nowUs >= m_firstAboveUs)
+    {
+        m_overloaded.store(true, std::memory_order_relaxed);
+    }
+}
+
 int ThreadsPool::getTaskCount()
 {
     std::lock_guard<std::mutex> lk(m_queueMtx);
-    return static_cast<int>(m_tasksQue.size());
+    return static_cast<int>(m_taskCnt);
 }
 
 int ThreadsPool::getAliveCount()
@@ -177,24 +287,26 @@ bool ThreadsPool::tryConsumeExit()
 void ThreadsPool::work()
 {
     m_alive.fetch_add(1);
+    // 绑定到工作线程 CPU 中线程最少的一个，-1 表示未绑定
+    int node = CpuAffinity::getInstance()->pin(CpuAffinity::WORKER);
 #ifdef DEBUG
     std::cout << "worker start, id=" << std::this_thread::get_id() << "\n";
 #endif
 
     while (true) 
     {
-        cb_fun task;
+        TaskItem item;
 
         {   // 获取任务的临界区
             std::unique_lock<std::mutex> lk(m_queueMtx);
 
             // 等待条件：队列非空 或 stop 或 有 exit 请求
             m_notEmpty.wait(lk, [&] {
-                return !m_tasksQue.empty() || m_isStop.load() || m_exitCnt.load() > 0;
+                return m_taskCnt > 0 || m_isStop.load() || m_exitCnt.load() > 0;
             });
 
             // 优先响应停止：若 stop 且 无任务，则退出
-            if (m_isStop.load() && m_tasksQue.empty()) {
+            if (m_isStop.load() && m_taskCnt == 0) {
 #ifdef DEBUG
                 std::cout << "worker stopping (stop flag), id=" << std::this_thread::get_id() << "\n";
 #endif
@@ -216,10 +328,10 @@ void ThreadsPool::work()
             }
 
             // 取任务
-            if (!m_tasksQue.empty()) 
+            if (popTask(node, item)) 
             {
-                task = std::move(m_tasksQue.front());
-                m_tasksQue.pop();
+                uint64_t now = Metrics::nowUs();
+                updateCodel(now - item.enqueueUs, now, m_taskCnt == 0);
             } 
             else 
             {
@@ -228,11 +340,18 @@ void ThreadsPool::work()
             }
         } // 解锁 queueMutex
 
+        Metrics::observe(Metrics::QUEUE_WAIT, Metrics::nowUs() - item.enqueueUs);
+        // 本节点没有任务时取了其他节点的，连接的缓冲区在远端内存上
+        if(node >= 0 && item.node >= 0 && item.node != node)
+        {
+            Metrics::inc(Metrics::REMOTE_TASKS);
+        }
+
         // 执行任务（busy 增/减）
         m_busy.fetch_add(1);
         try 
         {
-            task();
+            item.fn();
         } 
         catch (...) 
         {
@@ -245,6 +364,7 @@ void ThreadsPool::work()
     } // while
 
     // 线程退出前统一 decrement alive 并通知可能等待的析构/管理线程
+    CpuAffinity::getInstance()->unpin();
     m_alive.fetch_sub(1);
     m_mangerCV.notify_one();
 
@@ -268,7 +388,7 @@ void ThreadsPool::manager()
 
         if (m_isStop.load()) break;
 
-        int qsize = static_cast<int>(m_tasksQue.size());
+        int qsize = static_cast<int>(m_taskCnt);
         int busyCount = m_busy.load();
         int aliveCount = m_alive.load();
 
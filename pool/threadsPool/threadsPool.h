@@ -15,6 +15,8 @@
 #include <algorithm>
 
 #include "../utils/pathInfo.h"
+#include "../utils/cpuAffinity.h"
+#include "../../metrics/metrics.h"
 
 
 using std::cout;
@@ -22,11 +24,28 @@ using std::endl;
 using std::string;
 
 
+/**
+ *  动态线程池
+ *  - addTask：内部续作（写回、数据库协程恢复），不受队列上限约束
+ *  - admitTask：新请求的准入，队列满或 CoDel 判定过载时拒绝，由反应堆直接回 503
+ *  - CoDel：排队时间连续一个 interval 都高于 target 视为过载（存在常驻队列），
+ *    任一任务的排队时间回落到 target 以下或队列清空即解除
+ *  - 启用 CPU 绑定时按 NUMA 节点分队列：任务带上连接所属节点，工作线程先取本节点队列，
+ *    本节点没有任务再取其他节点的（不会因为某节点没有工作线程而饿死）
+ */
 class ThreadsPool
 {
 public:
     using cb_fun = std::function<void()>;
 
+    enum ADMIT
+    {
+        ADMIT_OK = 0,
+        ADMIT_OVERLOAD,         // CoDel 判定过载
+        ADMIT_QUEUE_FULL,       // 队列达到 maxQueue
+        ADMIT_STOPPED,
+    };
+
 public:
     ThreadsPool();
     ~ThreadsPool();
@@ -35,8 +54,11 @@ public:
     ThreadsPool(const ThreadsPool&) = delete;
     ThreadsPool& operator=(const ThreadsPool&) = delete;
 
-    bool addTask(cb_fun task);
+    /* node 为任务所属的 NUMA 节点，-1 表示不限 */
+    bool addTask(cb_fun task, int node = -1);
+    ADMIT admitTask(cb_fun task, int node = -1);
     int getTaskCount();
+    bool isOverloaded() const { return m_overloaded.load(std::memory_order_relaxed); }
 
     int getBuysCount();
     int getAliveCount();
@@ -50,6 +72,22 @@ private:
 
     bool tryConsumeExit();
 
+    /* 用队首任务的排队时间推进 CoDel 状态，需持有 m_queueMtx */
+    void updateCodel(uint64_t sojournUs, uint64_t nowUs, bool empty);
+
+    /* 队列中的任务，记录入队时间用于统计排队等待 */
+    struct TaskItem
+    {
+        cb_fun fn;
+        uint64_t enqueueUs;
+        int node;
+    };
+
+    /* 以下需持有 m_queueMtx */
+    void pushTask(cb_fun&& task, uint64_t nowUs, int node);
+    bool popTask(int node, TaskItem& item);
+    uint64_t oldestEnqueueUs() const;
+
 private:
     /* 线程池相关参数 */
     int m_maxNum;
@@ -60,7 +98,16 @@ private:
     /* 队列相关参数 */
     std::mutex m_queueMtx;
     std::condition_variable m_notEmpty;
-    std::queue<cb_fun> m_tasksQue;
+    std::vector<std::queue<TaskItem>> m_tasksQue;   // 每个 NUMA 节点一个队列，未启用 CPU 绑定时只有一个
+    size_t m_taskCnt;                   // 各队列任务总数
+    size_t m_nextQue;                   // 不限节点的任务轮流放入各队列
+    size_t m_maxQueue;                  // admitTask 的队列上限，0 为不限
+
+    /* CoDel 相关参数（微秒） */
+    uint64_t m_codelTarget;
+    uint64_t m_codelInterval;
+    uint64_t m_firstAboveUs;            // 排队时间首次超过 target 后的判定时刻，0 表示未超过
+    std::atomic<bool> m_overloaded;
     
     /* 线程 */
     std::condition_variable m_mangerCV;      // 用于管理线程/析构等待 alive==0
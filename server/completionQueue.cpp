@@ -0,0 +1,46 @@
+#include "completionQueue.h"
+
+#include <thread>
+
+CompletionQueue::CompletionQueue(size_t capacity)
+:m_queue(capacity), m_eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), m_signaled(false)
+{
+}
+
+CompletionQueue::~CompletionQueue()
+{
+    if(m_eventFd >= 0)
+    {
+        close(m_eventFd);
+    }
+}
+
+void CompletionQueue::post(HttpConn* client, OP op)
+{
+    // 容量按最大连接数分配，正常不会满；满了只能等反应堆取走
+    while(!m_queue.tryPush(Completion{client, op}))
+    {
+        std::this_thread::yield();
+    }
+
+    wakeup();
+}
+
+void CompletionQueue::wakeup()
+{
+    if(!m_signaled.exchange(true, std::memory_order_acq_rel))
+    {
+        uint64_t one = 1;
+        ssize_t ret = write(m_eventFd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+void CompletionQueue::clearSignal()
+{
+    uint64_t cnt;
+    ssize_t ret = read(m_eventFd, &cnt, sizeof(cnt));
+    (void)ret;
+    // 先清标志再由调用方取队列，之后的投递会重新唤醒
+    m_signaled.store(false, std::memory_order_release);
+}
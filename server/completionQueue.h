@@ -0,0 +1,73 @@
+#ifndef COMPLETIONQUEUE_H
+#define COMPLETIONQUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "../utils/mpmcQueue.h"
+
+class HttpConn;
+
+/**
+ *  工作线程 -> 反应堆的完成队列
+ *  - 工作线程处理完连接后投递“重新监听读/写”或“关闭”，由反应堆每轮统一执行，
+ *    epoll_ctl、定时器和连接表只在反应堆线程中修改
+ *  - 无锁有界队列；连接为 EPOLLONESHOT，同一时刻最多一个在途完成，容量不小于最大连接数即不会满
+ *  - 只有队列由空转为非空时才写 eventfd 唤醒反应堆
+ */
+class CompletionQueue
+{
+public:
+    enum OP
+    {
+        REARM_READ = 0,
+        REARM_WRITE,
+        CLOSE,
+    };
+
+    struct Completion
+    {
+        HttpConn* client;
+        OP op;
+    };
+
+public:
+    explicit CompletionQueue(size_t capacity);
+    ~CompletionQueue();
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    int fd() const { return m_eventFd; }
+
+    /* 工作线程调用 */
+    void post(HttpConn* client, OP op);
+    /* 只唤醒反应堆（例如新增了更早到期的等待），不投递完成 */
+    void wakeup();
+
+    /* 反应堆调用：eventfd 可读时清除信号 */
+    void clearSignal();
+
+    /* 反应堆调用：取出当前所有完成，返回个数 */
+    template<typename Fn>
+    size_t drain(Fn&& apply)
+    {
+        size_t n = 0;
+        Completion c;
+        while(m_queue.tryPop(c))
+        {
+            apply(c);
+            ++n;
+        }
+        return n;
+    }
+
+private:
+    MpmcQueue<Completion> m_queue;
+    int m_eventFd;
+    std::atomic<bool> m_signaled;       // 已写 eventfd 且反应堆尚未清除
+};
+
+#endif
@@ -1,5 +1,17 @@
 #include "epoller.h"
 
+// 较旧的内核头文件没有 epoll 忙轮询参数
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+    __u32 busy_poll_usecs;
+    __u16 busy_poll_budget;
+    __u8 prefer_busy_poll;
+    __u8 __pad;
+};
+#define EPIOCSPARAMS _IOW(0x8A, 0x01, struct epoll_params)
+#endif
+
 Epoller::Epoller(int maxEvents)
 :m_epollfd(epoll_create(512)), m_events(maxEvents)
 {
@@ -45,6 +57,16 @@ int Epoller::wait(int timeout)
     return epoll_wait(m_epollfd, &m_events[0], static_cast<int>(m_events.size()), timeout);
 }
 
+bool Epoller::setBusyPoll(uint32_t usecs, bool prefer)
+{
+    struct epoll_params params = {};
+    params.busy_poll_usecs = usecs;
+    params.busy_poll_budget = 8;        // 内核默认的 BUSY_POLL_BUDGET，更大需要 CAP_NET_ADMIN
+    params.prefer_busy_poll = prefer ? 1 : 0;
+
+    return ioctl(m_epollfd, EPIOCSPARAMS, &params) == 0;
+}
+
 int Epoller::getEventFd(size_t idx) const
 {
     assert(idx >= 0 && idx < m_events.size());
@@ -3,6 +3,8 @@
 
 
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <assert.h>
@@ -23,10 +25,15 @@ public:
 
     int wait(int timeout = -1);
 
+    /* epoll_wait 在内核中轮询网卡队列（Linux 6.9+，仅对有 NAPI 的网卡生效），不支持时返回 false */
+    bool setBusyPoll(uint32_t usecs, bool prefer);
+
     int getEventFd(size_t ) const;
 
     uint32_t getEvents(size_t) const;
 
+    int maxEvents() const { return static_cast<int>(m_events.size()); }
+
 private:
     int m_epollfd;
     std::vector<struct epoll_event> m_events;
@@ -0,0 +1,229 @@
+#include "ipLimiter.h"
+
+#include <iostream>
+
+IpLimiter::IpLimiter()
+:m_enable(false), m_maxConns(256), m_connRate(50), m_connBurst(100), m_reqRate(500), m_reqBurst(1000),
+m_tableSize(16384), m_staleUs(0), m_mask(0), m_untracked(0)
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "IpLimiter use default configuration..." << std::endl;
+#endif
+    }
+
+    if(!m_enable) return;
+
+    m_connBurst = std::max(m_connBurst, 1);
+    m_reqBurst = std::max(m_reqBurst, 1);
+
+    // 表大小取 2 的幂
+    size_t size = 64;
+    while(size < m_tableSize) size <<= 1;
+    m_table = std::vector<Entry>(size);
+    m_mask = size - 1;
+
+    uint64_t connFull = m_connRate > 0 ? static_cast<uint64_t>(m_connBurst) * 1000000 / m_connRate : 0;
+    uint64_t reqFull = m_reqRate > 0 ? static_cast<uint64_t>(m_reqBurst) * 1000000 / m_reqRate : 0;
+    m_staleUs = std::max(connFull, reqFull);
+}
+
+bool IpLimiter::loadConfigFile()
+{
+    string configPath = getConfigPath() + "ipLimit.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << configPath << std::endl;
+#endif
+    std::ifstream ifs(configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "enable")
+            {
+                m_enable = std::stoi(value) != 0;
+            }
+            else if(key == "maxconns")
+            {
+                m_maxConns = std::stoi(value);
+            }
+            else if(key == "connrate")
+            {
+                m_connRate = std::stoi(value);
+            }
+            else if(key == "connburst")
+            {
+                m_connBurst = std::stoi(value);
+            }
+            else if(key == "reqrate")
+            {
+                m_reqRate = std::stoi(value);
+            }
+            else if(key == "reqburst")
+            {
+                m_reqBurst = std::stoi(value);
+            }
+            else if(key == "tablesize")
+            {
+                m_tableSize = std::stoul(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+size_t IpLimiter::slot(uint32_t ip) const
+{
+    return (ip * 0x9E3779B1u) & m_mask;
+}
+
+IpLimiter::Entry* IpLimiter::find(uint32_t ip)
+{
+    size_t base = slot(ip);
+    for(int i = 0; i < PROBE; ++i)
+    {
+        Entry& e = m_table[(base + i) & m_mask];
+        if(e.ip.load(std::memory_order_acquire) == ip)
+        {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+IpLimiter::Entry* IpLimiter::findOrCreate(uint32_t ip, uint64_t nowUs)
+{
+    size_t base = slot(ip);
+    Entry* victim = nullptr;
+
+    for(int i = 0; i < PROBE; ++i)
+    {
+        Entry& e = m_table[(base + i) & m_mask];
+        uint32_t key = e.ip.load(std::memory_order_relaxed);
+        if(key == ip)
+        {
+            return &e;
+        }
+
+        // 候选：空表项优先，其次是无连接且令牌桶已回满的表项
+        if(victim && victim->ip.load(std::memory_order_relaxed) == 0)
+        {
+            continue;
+        }
+        if(key == 0 || (e.conns.load(std::memory_order_relaxed) == 0 && nowUs - e.lastUs >= m_staleUs))
+        {
+            victim = &e;
+        }
+    }
+
+    if(victim == nullptr)
+    {
+        return nullptr;
+    }
+
+    victim->conns.store(0, std::memory_order_relaxed);
+    victim->lastUs = nowUs;
+    victim->connBucket = { static_cast<uint64_t>(m_connBurst) * TOKEN, nowUs };
+    victim->reqBucket = { static_cast<uint64_t>(m_reqBurst) * TOKEN, nowUs };
+    victim->ip.store(ip, std::memory_order_release);
+    return victim;
+}
+
+bool IpLimiter::take(Bucket& bucket, int rate, int burst, uint64_t nowUs)
+{
+    if(rate <= 0) return true;
+
+    uint64_t cap = static_cast<uint64_t>(burst) * TOKEN;
+    if(nowUs > bucket.stampUs)
+    {
+        bucket.tokens = std::min(cap, bucket.tokens + (nowUs - bucket.stampUs) * rate);
+        bucket.stampUs = nowUs;
+    }
+
+    if(bucket.tokens < TOKEN) return false;
+    bucket.tokens -= TOKEN;
+    return true;
+}
+
+uint32_t IpLimiter::key(const sockaddr_storage& addr)
+{
+    if(addr.ss_family != AF_INET) return 0;
+    return reinterpret_cast<const sockaddr_in*>(&addr)->sin_addr.s_addr;
+}
+
+IpLimiter::RESULT IpLimiter::acquireConn(const sockaddr_storage& addr, uint64_t nowUs, bool* counted)
+{
+    *counted = false;
+    uint32_t ip = key(addr);
+    if(!m_enable || ip == 0) return PASS;
+
+    Entry* e = findOrCreate(ip, nowUs);
+    if(e == nullptr)
+    {
+        m_untracked.fetch_add(1, std::memory_order_relaxed);
+        return PASS;
+    }
+    e->lastUs = nowUs;
+
+    if(m_maxConns > 0 && e->conns.load(std::memory_order_relaxed) >= m_maxConns)
+    {
+        return CONN_LIMIT;
+    }
+    if(!take(e->connBucket, m_connRate, m_connBurst, nowUs))
+    {
+        return CONN_RATE;
+    }
+
+    e->conns.fetch_add(1, std::memory_order_relaxed);
+    *counted = true;
+    return PASS;
+}
+
+void IpLimiter::releaseConn(const sockaddr_storage& addr)
+{
+    uint32_t ip = key(addr);
+    if(!m_enable || ip == 0) return;
+
+    // 有连接的表项不会被复用，计数过的连接一定还能找到自己的表项
+    Entry* e = find(ip);
+    if(e == nullptr) return;
+
+    int32_t n = e->conns.load(std::memory_order_relaxed);
+    while(n > 0 && !e->conns.compare_exchange_weak(n, n - 1, std::memory_order_relaxed))
+    {
+    }
+}
+
+IpLimiter::RESULT IpLimiter::allowRequest(const sockaddr_storage& addr, uint64_t nowUs)
+{
+    uint32_t ip = key(addr);
+    if(!m_enable || m_reqRate <= 0 || ip == 0) return PASS;
+
+    Entry* e = find(ip);
+    if(e == nullptr) return PASS;
+
+    e->lastUs = nowUs;
+    return take(e->reqBucket, m_reqRate, m_reqBurst, nowUs) ? PASS : REQ_RATE;
+}
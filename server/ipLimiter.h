@@ -0,0 +1,101 @@
+#ifndef IPLIMITER_H
+#define IPLIMITER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../utils/pathInfo.h"
+
+using std::string;
+
+/**
+ *  按来源 IP 限制并发连接数、每秒新建连接数和每秒请求数
+ *  - 定长开放寻址表，按 IPv4 地址散列，只在固定窗口内线性探测，内存在启动时一次分配
+ *  - 速率用令牌桶（放大 1e6 倍的整数），只由反应堆读写
+ *  - 并发连接数为原子量，连接可能在工作线程中关闭
+ *  - 表项空闲且令牌桶已回满时可以被无损复用；窗口内无可用表项则放行并计数
+ *  - 只限制 IPv4 对端，Unix 域套接字的连接都来自本机反向代理，不限流
+ */
+class IpLimiter
+{
+public:
+    enum RESULT
+    {
+        PASS = 0,
+        CONN_LIMIT,         // 并发连接数超限
+        CONN_RATE,          // 新建连接速率超限
+        REQ_RATE,           // 请求速率超限
+    };
+
+public:
+    IpLimiter();
+
+    IpLimiter(const IpLimiter&) = delete;
+    IpLimiter& operator=(const IpLimiter&) = delete;
+
+    bool enabled() const { return m_enable; }
+
+    /* 反应堆调用：accept 之后、初始化连接之前；counted 返回本连接是否计入了并发数 */
+    RESULT acquireConn(const sockaddr_storage& addr, uint64_t nowUs, bool* counted);
+    /* 任意线程调用：只对 counted 为 true 的连接调用，与 acquireConn 一一对应 */
+    void releaseConn(const sockaddr_storage& addr);
+    /* 反应堆调用：每次分发读事件 */
+    RESULT allowRequest(const sockaddr_storage& addr, uint64_t nowUs);
+
+    size_t capacity() const { return m_table.size(); }
+    uint64_t getUntracked() const { return m_untracked.load(std::memory_order_relaxed); }
+
+private:
+    static const int PROBE = 8;                 // 探测窗口
+    static const uint64_t TOKEN = 1000000;      // 一个令牌
+
+    struct Bucket
+    {
+        uint64_t tokens;
+        uint64_t stampUs;
+    };
+
+    struct Entry
+    {
+        std::atomic<uint32_t> ip{0};            // 0 表示空（0.0.0.0 不会是对端地址）
+        std::atomic<int32_t> conns{0};
+        uint64_t lastUs = 0;
+        Bucket connBucket = { 0, 0 };
+        Bucket reqBucket = { 0, 0 };
+    };
+
+    bool loadConfigFile();
+
+    Entry* find(uint32_t ip);
+    Entry* findOrCreate(uint32_t ip, uint64_t nowUs);
+    size_t slot(uint32_t ip) const;
+
+    /* IPv4 地址作为键，其余地址族返回 0（不跟踪） */
+    static uint32_t key(const sockaddr_storage& addr);
+
+    static bool take(Bucket& bucket, int rate, int burst, uint64_t nowUs);
+
+private:
+    bool m_enable;
+    int m_maxConns;         // 0 为不限
+    int m_connRate;         // 每秒，0 为不限
+    int m_connBurst;
+    int m_reqRate;
+    int m_reqBurst;
+    size_t m_tableSize;
+
+    uint64_t m_staleUs;     // 空闲表项经过该时长后令牌桶必然回满，可以无损复用
+
+    std::vector<Entry> m_table;
+    size_t m_mask;
+
+    std::atomic<uint64_t> m_untracked;      // 探测窗口已满而未受限的连接数
+};
+
+#endif
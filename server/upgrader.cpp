@@ -0,0 +1,291 @@
+#include "upgrader.h"
+
+#include <fstream>
+#include <iterator>
+#include <climits>
+#include <cstdlib>
+
+extern char** environ;
+
+const char* Upgrader::ENV_FD = "WEBSERVER_UPGRADE_FD";
+int Upgrader::s_signalFd = -1;
+
+Upgrader::Upgrader()
+:m_channel(-1), m_childPid(-1)
+{
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if(len > 0)
+    {
+        m_exePath.assign(path, len);
+    }
+
+    // 参数以 '\0' 分隔
+    std::ifstream ifs("/proc/self/cmdline", std::ios::binary);
+    string cmdline((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    size_t start = 0;
+    while(start < cmdline.size())
+    {
+        size_t end = cmdline.find('\0', start);
+        if(end == string::npos) end = cmdline.size();
+        m_args.push_back(cmdline.substr(start, end - start));
+        start = end + 1;
+    }
+
+    if(s_signalFd < 0)
+    {
+        s_signalFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR2, &sa, nullptr);
+}
+
+Upgrader::~Upgrader()
+{
+    closeChannel();
+}
+
+void Upgrader::onSignal(int)
+{
+    // 信号处理函数中只做异步信号安全的 write
+    int saved = errno;
+    uint64_t one = 1;
+    ssize_t ret = write(s_signalFd, &one, sizeof(one));
+    (void)ret;
+    errno = saved;
+}
+
+void Upgrader::clearSignal()
+{
+    uint64_t cnt;
+    ssize_t ret = read(s_signalFd, &cnt, sizeof(cnt));
+    (void)ret;
+}
+
+bool Upgrader::sendFds(int sock, const std::vector<int>& fds)
+{
+    if(fds.empty() || fds.size() > MAX_FDS)
+    {
+        return false;
+    }
+
+    char data = 'L';
+    struct iovec iov = { &data, 1 };
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctrl;
+    memset(&ctrl, 0, sizeof(ctrl));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1;
+}
+
+std::vector<int> Upgrader::recvFds(int sock)
+{
+    std::vector<int> fds;
+    char data;
+    struct iovec iov = { &data, 1 };
+
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+        struct cmsghdr align;
+    } ctrl;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t ret;
+    do
+    {
+        ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while(ret < 0 && errno == EINTR);
+    if(ret != 1)
+    {
+        return fds;
+    }
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if(cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        return fds;
+    }
+
+    size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    fds.resize(n);
+    memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * n);
+    return fds;
+}
+
+std::vector<int> Upgrader::inheritListenFds()
+{
+    const char* env = getenv(ENV_FD);
+    if(env == nullptr)
+    {
+        return {};
+    }
+
+    // 之后本进程再升级时不能沿用
+    m_channel = atoi(env);
+    unsetenv(ENV_FD);
+    fcntl(m_channel, F_SETFD, FD_CLOEXEC);
+
+    std::vector<int> fds = recvFds(m_channel);
+    if(fds.empty())
+    {
+        LOG_ERROR("upgrade: receive listen socket failed: %s", strerror(errno));
+        closeChannel();
+    }
+    return fds;
+}
+
+void Upgrader::notifyReady()
+{
+    if(m_channel < 0)
+    {
+        return;
+    }
+
+    char data = 'R';
+    if(send(m_channel, &data, 1, MSG_NOSIGNAL) != 1)
+    {
+        LOG_WARN("upgrade: notify old process failed: %s", strerror(errno));
+    }
+    closeChannel();
+}
+
+bool Upgrader::start(const std::vector<int>& listenFds)
+{
+    if(inProgress() || m_exePath.empty() || m_args.empty())
+    {
+        return false;
+    }
+
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        LOG_ERROR("upgrade: socketpair failed: %s", strerror(errno));
+        return false;
+    }
+
+    // fork 之后子进程只能调用异步信号安全的函数，参数和环境变量提前准备好
+    std::vector<char*> argv;
+    for(string& arg : m_args)
+    {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    string envFd = string(ENV_FD) + "=" + std::to_string(sv[1]);
+    std::vector<char*> envp;
+    size_t prefix = strlen(ENV_FD) + 1;
+    for(char** e = environ; *e; ++e)
+    {
+        if(strncmp(*e, envFd.c_str(), prefix) != 0)
+        {
+            envp.push_back(*e);
+        }
+    }
+    envp.push_back(const_cast<char*>(envFd.c_str()));
+    envp.push_back(nullptr);
+    cpu_set_t cpus = CpuAffinity::getInstance()->processCpus();
+
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        LOG_ERROR("upgrade: fork failed: %s", strerror(errno));
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if(pid == 0)
+    {
+        // 只有通道的一端留给新进程，其余 fd 都带 CLOEXEC
+        fcntl(sv[1], F_SETFD, 0);
+        // start 在反应堆线程上调用，新进程不继承反应堆的 CPU 绑定
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+        execve(m_exePath.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+
+    close(sv[1]);
+    m_channel = sv[0];
+    m_childPid = pid;
+
+    if(!sendFds(m_channel, listenFds))
+    {
+        // 对端已关闭说明新进程已经退出（通常是 exec 失败），直接回收
+        LOG_ERROR("upgrade: send listen socket failed: %s", strerror(errno));
+        waitpid(pid, nullptr, 0);
+        closeChannel();
+        return false;
+    }
+
+    fcntl(m_channel, F_SETFL, fcntl(m_channel, F_GETFL) | O_NONBLOCK);
+    LOG_INFO("upgrade: started %s as pid %d", m_exePath.c_str(), pid);
+    return true;
+}
+
+Upgrader::RESULT Upgrader::onChannel()
+{
+    char data = 0;
+    ssize_t ret = recv(m_channel, &data, 1, 0);
+    if(ret < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return PENDING;
+    }
+
+    if(ret == 1 && data == 'R')
+    {
+        LOG_INFO("upgrade: pid %d is serving", m_childPid);
+        closeChannel();
+        return READY;
+    }
+
+    // 新进程在就绪前退出或通道出错：通道关闭不代表进程已经退出，先确保它终止再阻塞回收，避免留下僵尸进程
+    int status = 0;
+    if(waitpid(m_childPid, &status, WNOHANG) == 0)
+    {
+        kill(m_childPid, SIGKILL);
+        while(waitpid(m_childPid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+    }
+    LOG_ERROR("upgrade: pid %d failed before serving, status %d", m_childPid, status);
+    closeChannel();
+    return FAILED;
+}
+
+void Upgrader::closeChannel()
+{
+    if(m_channel >= 0)
+    {
+        close(m_channel);
+        m_channel = -1;
+    }
+    m_childPid = -1;
+}
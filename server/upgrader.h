@@ -0,0 +1,79 @@
+#ifndef UPGRADER_H
+#define UPGRADER_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
+
+#include "../log/log.h"
+#include "../utils/cpuAffinity.h"
+
+using std::string;
+
+/**
+ *  不停机升级（监听套接字交接）
+ *  - 旧进程收到 SIGUSR2 后 fork + exec 磁盘上的新二进制（参数不变），
+ *    通过 AF_UNIX socketpair 用 SCM_RIGHTS 把监听套接字（TCP 和 Unix 域）交给新进程
+ *  - 新进程直接在继承的套接字上 accept，两进程共享同一个全连接队列，交接期间不丢连接
+ *  - 新进程开始事件循环后回一个字节，旧进程随即停止 accept 并排空已有连接；
+ *    新进程启动失败（通道 EOF）则旧进程继续服务
+ */
+class Upgrader
+{
+public:
+    enum RESULT
+    {
+        PENDING = 0,        // 新进程尚未就绪
+        READY,              // 新进程已开始服务
+        FAILED,             // 新进程退出或通道出错
+    };
+
+    static const char* ENV_FD;      // 传给新进程的通道 fd 环境变量
+    static const int MAX_FDS = 4;   // 一次交接的监听套接字上限
+
+public:
+    Upgrader();
+    ~Upgrader();
+
+    Upgrader(const Upgrader&) = delete;
+    Upgrader& operator=(const Upgrader&) = delete;
+
+    /* 新进程：取出旧进程交来的监听套接字，非升级启动返回空 */
+    std::vector<int> inheritListenFds();
+    /* 新进程：事件循环就绪后通知旧进程 */
+    void notifyReady();
+
+    /* 旧进程：SIGUSR2 到达时可读 */
+    int signalFd() const { return s_signalFd; }
+    void clearSignal();
+
+    /* 旧进程：启动新进程并发送监听套接字，通道可读时调用 onChannel */
+    bool start(const std::vector<int>& listenFds);
+    int channelFd() const { return m_channel; }
+    bool inProgress() const { return m_childPid > 0; }
+    RESULT onChannel();
+
+private:
+    static bool sendFds(int sock, const std::vector<int>& fds);
+    static std::vector<int> recvFds(int sock);
+    static void onSignal(int sig);
+
+    void closeChannel();
+
+private:
+    string m_exePath;               // 启动时解析，磁盘上的文件被替换后仍指向同一路径
+    std::vector<string> m_args;
+    int m_channel;
+    pid_t m_childPid;
+
+    static int s_signalFd;
+};
+
+#endif
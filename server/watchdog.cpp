@@ -0,0 +1,129 @@
+#include "watchdog.h"
+
+#include <execinfo.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdlib>
+
+namespace
+{
+
+const int MAX_FRAMES = 64;
+
+// 信号处理函数只写这几个变量
+void* g_frames[MAX_FRAMES];
+std::atomic<int> g_depth{0};
+std::atomic<bool> g_sampled{false};
+
+int stackSignal()
+{
+    return SIGRTMIN + 3;
+}
+
+}
+
+Watchdog::Watchdog(int thresholdMs)
+:m_thresholdUs(static_cast<uint64_t>(thresholdMs) * 1000), m_reactorTid(0), m_busySince(0),
+m_lastReported(0), m_stop(false)
+{
+}
+
+Watchdog::~Watchdog()
+{
+    stop();
+}
+
+void Watchdog::start(pid_t reactorTid)
+{
+    if(m_thread.joinable() || m_thresholdUs == 0) return;
+
+    m_reactorTid = reactorTid;
+
+    // 预先调用一次，第一次 backtrace 会加载 libgcc，不能放在信号处理函数里
+    void* warm[2];
+    backtrace(warm, 2);
+
+    struct sigaction sa = {};
+    sa.sa_handler = &Watchdog::onSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(stackSignal(), &sa, nullptr);
+
+    m_thread = std::thread(&Watchdog::run, this);
+}
+
+void Watchdog::stop()
+{
+    if(!m_thread.joinable()) return;
+
+    m_stop.store(true);
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+void Watchdog::onSignal(int)
+{
+    g_depth.store(backtrace(g_frames, MAX_FRAMES), std::memory_order_relaxed);
+    g_sampled.store(true, std::memory_order_release);
+}
+
+std::vector<std::string> Watchdog::sampleStack()
+{
+    std::vector<std::string> stack;
+    g_sampled.store(false);
+    if(syscall(SYS_tgkill, getpid(), m_reactorTid, stackSignal()) < 0)
+    {
+        return stack;
+    }
+
+    // 最多等 50ms，反应堆可能刚好恢复并进入 epoll_wait
+    for(int i = 0; i < 50 && !g_sampled.load(std::memory_order_acquire); ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if(!g_sampled.load(std::memory_order_acquire)) return stack;
+
+    int depth = g_depth.load(std::memory_order_relaxed);
+    char** symbols = backtrace_symbols(g_frames, depth);
+    if(symbols == nullptr) return stack;
+
+    // 跳过信号处理函数和信号跳板两帧
+    for(int i = 2; i < depth; ++i)
+    {
+        stack.emplace_back(symbols[i]);
+    }
+    free(symbols);
+    return stack;
+}
+
+void Watchdog::run()
+{
+    // 检查间隔取阈值的一半，卡顿最迟在 1.5 倍阈值时被发现
+    auto interval = std::chrono::microseconds(std::max<uint64_t>(m_thresholdUs / 2, 1000));
+
+    while(!m_stop.load())
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_mtx);
+            m_cv.wait_for(locker, interval, [this]{ return m_stop.load(); });
+        }
+
+        uint64_t since = m_busySince.load(std::memory_order_relaxed);
+        if(since == 0 || since == m_lastReported) continue;
+
+        uint64_t busy = Metrics::nowUs() - since;
+        if(busy < m_thresholdUs) continue;
+
+        m_lastReported = since;
+        Metrics::inc(Metrics::LOOP_STALLS);
+        std::vector<std::string> stack = sampleStack();
+        LOG_WARN("event loop stalled for %llums (threshold %llums), reactor stack%s",
+            static_cast<unsigned long long>(busy / 1000), static_cast<unsigned long long>(m_thresholdUs / 1000),
+            stack.empty() ? " unavailable" : ":");
+        for(size_t i = 0; i < stack.size(); ++i)
+        {
+            LOG_WARN("    #%zu %s", i, stack[i].c_str());
+        }
+    }
+}
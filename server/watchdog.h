@@ -0,0 +1,56 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "../metrics/metrics.h"
+#include "../log/log.h"
+
+/**
+ *  事件循环卡顿看门狗
+ *  反应堆在 epoll_wait 返回时记下开始忙碌的时间、再次进入 epoll_wait 前清零，
+ *  看门狗线程周期检查，忙碌超过阈值即记一次卡顿，并向反应堆线程发信号抓取调用栈写入错误日志
+ */
+class Watchdog
+{
+public:
+    explicit Watchdog(int thresholdMs);
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    void start(pid_t reactorTid);
+    void stop();
+
+    /* 反应堆调用，只有一次 relaxed 写 */
+    void beginIter(uint64_t nowUs) { m_busySince.store(nowUs, std::memory_order_relaxed); }
+    void endIter() { m_busySince.store(0, std::memory_order_relaxed); }
+
+    uint64_t thresholdUs() const { return m_thresholdUs; }
+
+private:
+    void run();
+    std::vector<std::string> sampleStack();
+
+    static void onSignal(int sig);
+
+private:
+    uint64_t m_thresholdUs;
+    pid_t m_reactorTid;
+    std::atomic<uint64_t> m_busySince;
+    uint64_t m_lastReported;        // 同一次卡顿只报告一次
+
+    std::atomic<bool> m_stop;
+    std::mutex m_mtx;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+};
+
+#endif
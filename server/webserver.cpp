@@ -3,9 +3,14 @@
 
 
 
-Webserver::Webserver(int port, int trigMode, int timeoutMS, bool optLinger)
-:m_port(port),m_timeout(timeoutMS), m_openLinger(optLinger),m_timer(new MinHeapTimer()), 
-m_threadsPool(new ThreadsPool()), m_epoller(new Epoller()) 
+Webserver::Webserver(int port, int trigMode, int timeoutMS, bool optLinger, const string& unixPath)
+:m_port(port),m_timeout(timeoutMS), m_openLinger(optLinger), m_isClose(false), 
+m_listenFd(-1), m_reserveFd(-1), m_stallThreshold(100), m_backlog(1024), m_acceptBatch(64), m_deferAccept(1), m_fastOpen(256),
+m_keepAliveMax(100), m_keepAliveTimeout(0), m_keepAliveMinTimeout(1000), m_keepAliveLow(50), m_keepAliveHigh(90),
+m_memoryLimit(0), m_connCapacity(MAX_FD), m_memPressure(0), m_rssCheckUs(0),
+m_unixPerm(0660), m_unixFd(-1), m_retryAfter(1), m_reactorIo(false), m_busyPoll(0), m_busyPollSocket(50), m_inlineRequests(false),
+m_timer(new MinHeapTimer()), m_threadsPool(new ThreadsPool()), m_epoller(new Epoller()), m_ipLimiter(new IpLimiter()), m_completions(new CompletionQueue(MAX_FD)), m_upgrader(new Upgrader()),
+m_draining(false), m_drainDeadlineUs(0), m_upgradeDrain(30000), m_upgradeIdleClose(1000), m_asyncDb(false)
 {
     m_srcDir = getSrcPath() + "/resources/";
 #ifdef DEBUG
@@ -15,20 +20,298 @@ m_threadsPool(new ThreadsPool()), m_epoller(new Epoller())
     HttpConn::userCount = 0;
     HttpConn::srcDir = m_srcDir.c_str();
 
+    m_stagePolicy[HttpConn::STAGE_HEADER] = { 10000, 30000, 500 };
+    m_stagePolicy[HttpConn::STAGE_BODY] = { 10000, 0, 1024 };
+    m_stagePolicy[HttpConn::STAGE_DRAIN] = { 10000, 0, 1024 };
+
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "Webserver use default configuration..." << std::endl;
+#endif
+    }
+    // 命令行指定的 Unix 域套接字路径优先于配置文件
+    if(!unixPath.empty())
+    {
+        m_unixPath = unixPath;
+    }
+    // 空闲和服务端处理阶段沿用原来的连接超时（空闲阶段实际按各连接通告的长连接超时）
+    m_stagePolicy[HttpConn::STAGE_IDLE] = { m_timeout, 0, 0 };
+    m_stagePolicy[HttpConn::STAGE_PROCESS] = { m_timeout, 0, 0 };
+    initKeepAlive();
+    m_watchdog.reset(new Watchdog(std::max(m_stallThreshold, 0)));
+    initRejectResponses();
+
+    // 对端已关闭时 writev 会触发 SIGPIPE，默认动作是终止进程
+    signal(SIGPIPE, SIG_IGN);
+
     initEventMode(trigMode);
 
+    // 异步模式：登录/注册的数据库查询在协程中完成（仅 MySQL 后端）
+    if(AuthStore::backend() == AuthStore::BACKEND_MYSQL)
+    {
+        // 注册的组提交完成后在线程池中恢复协程，等待期间不占用工作线程
+        RegisterBatcher::getInstance()->setWatcher(this);
+        HttpRequest::asyncRegister = true;
+
+        DbConnsPool* pool = DbConnsPool::getInstance();
+        if(pool->isAsyncMode() && pool->initAsync(this))
+        {
+            m_asyncDb = true;
+            HttpRequest::asyncVerify = true;
+        }
+    }
+
+    initMetrics();
+    Trace::init();
+
     if(!initSocket())
     {
+        LOG_ERROR("server init failed on port %d: %s", m_port, strerror(errno));
         m_isClose = true;
     }
+    else
+    {
+        LOG_INFO("server start, port %d, unix %s, trigMode %d, timeout %dms, ioMode %s, busyPoll %dus, inline %d", m_port,
+            m_unixPath.empty() ? "-" : m_unixPath.c_str(), trigMode, m_timeout, m_reactorIo ? "reactor" : "pool",
+            m_busyPoll, m_inlineRequests ? 1 : 0);
+    }
 
 }
 
 Webserver::~Webserver()
 {
+    m_watchdog->stop();
     close(m_listenFd);
+    if(m_unixFd >= 0)
+    {
+        close(m_unixFd);
+        // 升级退出时套接字文件已由新进程接管
+        if(!m_draining)
+        {
+            unlink(m_unixPath.c_str());
+        }
+    }
+    if(m_reserveFd >= 0)
+    {
+        close(m_reserveFd);
+    }
     m_isClose = true;
-    DbConnsPool::getInstance()->~DbConnsPool();
+    if(AuthStore::backend() == AuthStore::BACKEND_MYSQL)
+    {
+        DbConnsPool::getInstance()->close();
+    }
+}
+
+bool Webserver::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "server.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << m_configPath << std::endl;
+#endif
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "stallthreshold")
+            {
+                m_stallThreshold = std::stoi(value);
+            }
+            else if(key == "retryafter")
+            {
+                m_retryAfter = std::stoi(value);
+            }
+            else if(key == "iomode")
+            {
+                m_reactorIo = (value == "reactor");
+            }
+            else if(key == "backlog")
+            {
+                m_backlog = std::stoi(value);
+            }
+            else if(key == "acceptbatch")
+            {
+                m_acceptBatch = std::max(std::stoi(value), 1);
+            }
+            else if(key == "deferaccept")
+            {
+                m_deferAccept = std::stoi(value);
+            }
+            else if(key == "unixpath")
+            {
+                m_unixPath = value;
+            }
+            else if(key == "unixperm")
+            {
+                m_unixPerm = std::stoi(value, nullptr, 8);
+            }
+            else if(key == "fastopen")
+            {
+                m_fastOpen = std::stoi(value);
+            }
+            else if(key == "headertimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_HEADER].timeout = std::stoi(value);
+            }
+            else if(key == "headermaxtimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_HEADER].maxTimeout = std::stoi(value);
+            }
+            else if(key == "headerminrate")
+            {
+                m_stagePolicy[HttpConn::STAGE_HEADER].minRate = std::stoi(value);
+            }
+            else if(key == "bodytimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_BODY].timeout = std::stoi(value);
+            }
+            else if(key == "bodymaxtimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_BODY].maxTimeout = std::stoi(value);
+            }
+            else if(key == "bodyminrate")
+            {
+                m_stagePolicy[HttpConn::STAGE_BODY].minRate = std::stoi(value);
+            }
+            else if(key == "draintimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_DRAIN].timeout = std::stoi(value);
+            }
+            else if(key == "drainmaxtimeout")
+            {
+                m_stagePolicy[HttpConn::STAGE_DRAIN].maxTimeout = std::stoi(value);
+            }
+            else if(key == "drainminrate")
+            {
+                m_stagePolicy[HttpConn::STAGE_DRAIN].minRate = std::stoi(value);
+            }
+            else if(key == "upgradedraintimeout")
+            {
+                m_upgradeDrain = std::stoi(value);
+            }
+            else if(key == "upgradeidleclose")
+            {
+                m_upgradeIdleClose = std::stoi(value);
+            }
+            else if(key == "busypoll")
+            {
+                m_busyPoll = std::stoi(value);
+            }
+            else if(key == "busypollsocket")
+            {
+                m_busyPollSocket = std::stoi(value);
+            }
+            else if(key == "inlinerequests")
+            {
+                m_inlineRequests = std::stoi(value) != 0;
+            }
+            else if(key == "keepalivemax")
+            {
+                m_keepAliveMax = std::stoi(value);
+            }
+            else if(key == "keepalivetimeout")
+            {
+                m_keepAliveTimeout = std::stoi(value);
+            }
+            else if(key == "keepalivemintimeout")
+            {
+                m_keepAliveMinTimeout = std::stoi(value);
+            }
+            else if(key == "keepalivelowwater")
+            {
+                m_keepAliveLow = std::stoi(value);
+            }
+            else if(key == "keepalivehighwater")
+            {
+                m_keepAliveHigh = std::stoi(value);
+            }
+            else if(key == "memorylimit")
+            {
+                m_memoryLimit = std::stoi(value);
+            }
+            else if(key == "maxheadersize")
+            {
+                HttpConn::maxHeaderSize = std::stoul(value);
+            }
+            else if(key == "maxbodysize")
+            {
+                HttpConn::maxBodySize = std::stoul(value);
+            }
+            else if(key == "tcpcork")
+            {
+                HttpConn::corkResponses = std::stoi(value) != 0;
+            }
+            else if(key == "smallresponse")
+            {
+                HttpConn::smallResponse = std::stoi(value);
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+void Webserver::initMetrics()
+{
+    Metrics::addCollector("webserver_active_connections", "gauge", "Currently open client connections.",
+        []{ return static_cast<double>(HttpConn::userCount.load()); });
+
+    ThreadsPool* pool = m_threadsPool.get();
+    Metrics::addCollector("webserver_task_queue_length", "gauge", "Tasks waiting in the thread pool queue.",
+        [pool]{ return static_cast<double>(pool->getTaskCount()); });
+    Metrics::addCollector("webserver_overloaded", "gauge", "1 while CoDel considers the task queue overloaded.",
+        [pool]{ return pool->isOverloaded() ? 1.0 : 0.0; });
+    Metrics::addCollector("webserver_busy_workers", "gauge", "Worker threads currently running a task.",
+        [pool]{ return static_cast<double>(pool->getBuysCount()); });
+
+    Metrics::addCollector("webserver_credential_cache_hits_total", "counter", "Logins answered from the credential cache.",
+        []{ return static_cast<double>(CredentialCache::getInstance()->getHits()); });
+    Metrics::addCollector("webserver_credential_cache_misses_total", "counter", "Logins that fell through to the auth store.",
+        []{ return static_cast<double>(CredentialCache::getInstance()->getMisses()); });
+    Metrics::addCollector("webserver_sessions", "gauge", "Live login sessions.",
+        []{ return static_cast<double>(SessionStore::getInstance()->size()); });
+
+    Epoller* epoller = m_epoller.get();
+    Metrics::addCollector("webserver_epoll_max_events", "gauge", "Size of the epoll_wait event array.",
+        [epoller]{ return static_cast<double>(epoller->maxEvents()); });
+
+    Metrics::addCollector("webserver_keepalive_max_requests", "gauge", "Per-connection request cap currently advertised (0 disables keep-alive).",
+        []{ return static_cast<double>(HttpConn::keepAliveMax.load(std::memory_order_relaxed)); });
+    Metrics::addCollector("webserver_keepalive_timeout_seconds", "gauge", "Keep-alive idle timeout currently advertised.",
+        []{ return HttpConn::keepAliveTimeout.load(std::memory_order_relaxed) / 1000.0; });
+    int capacity = m_connCapacity;
+    Metrics::addCollector("webserver_connection_capacity", "gauge", "Connections the server can hold before running out of descriptors.",
+        [capacity]{ return static_cast<double>(capacity); });
+
+    IpLimiter* limiter = m_ipLimiter.get();
+    Metrics::addCollector("webserver_ip_untracked_total", "counter", "Connections accepted without a per-IP limit because the probe window was full.",
+        [limiter]{ return static_cast<double>(limiter->getUntracked()); });
+
+    Metrics::addCollector("webserver_log_records_total", "counter", "Log records written to disk.",
+        []{ return static_cast<double>(Log::getInstance()->getWritten()); });
+    Metrics::addCollector("webserver_log_dropped_total", "counter", "Log records dropped because a thread ring was full.",
+        []{ return static_cast<double>(Log::getInstance()->getDropped()); });
 }
 
 void Webserver::initEventMode(int trigMode)
@@ -64,23 +347,97 @@ void Webserver::run()
 {
     int timeMS = -1;
 
+    if(Trace::active())
+    {
+        Trace::setThreadName("reactor");
+    }
+
+    m_watchdog->start(static_cast<pid_t>(syscall(SYS_gettid)));
+    uint64_t busySince = 0;
+    // 线程池、数据库、看门狗等线程都已创建，反应堆的绑定不会被它们继承
+    CpuAffinity::getInstance()->pin(CpuAffinity::REACTOR);
+
+    // 热升级启动时通知旧进程停止 accept
+    m_upgrader->notifyReady();
+
     while(!m_isClose)
     {
+        uint64_t timerStart = Metrics::nowUs();
+        timeMS = -1;
         if(m_timeout > 0)
         {
             // timeMS 得到下一个超时时间
             timeMS = m_timer->getNextTick();
         }
 
-        int eventCnt = m_epoller->wait(timeMS);
+        // 清理过期的会话，并把会话的到期时间计入等待超时
+        int sessionMS = SessionStore::getInstance()->getNextTick();
+        if(sessionMS >= 0 && (timeMS < 0 || sessionMS < timeMS))
+        {
+            timeMS = sessionMS;
+        }
+
+        // 数据库查询的等待超时
+        if(m_asyncDb)
+        {
+            int dbMS = checkDbTimeouts();
+            if(dbMS >= 0 && (timeMS < 0 || dbMS < timeMS))
+            {
+                timeMS = dbMS;
+            }
+        }
+
+        updateKeepAlive(timerStart);
+
+        // 升级排空期间周期检查剩余连接
+        if(m_draining)
+        {
+            checkDrain();
+            if(timeMS < 0 || timeMS > DRAIN_CHECK_MS)
+            {
+                timeMS = DRAIN_CHECK_MS;
+            }
+        }
+
+        uint64_t waitStart = Metrics::nowUs();
+        Metrics::observe(Metrics::LOOP_TIMER, waitStart - timerStart);
+
+        // 本轮忙碌时长：上次 epoll_wait 返回到现在（分发 + 定时器）
+        uint64_t threshold = m_watchdog->thresholdUs();
+        if(busySince && threshold && waitStart - busySince >= threshold)
+        {
+            Metrics::observe(Metrics::LOOP_STALL_TIME, waitStart - busySince);
+        }
+
+        m_watchdog->endIter();
+        int eventCnt = pollEvents(timeMS);
+        busySince = Metrics::nowUs();
+        m_watchdog->beginIter(busySince);
+
         for(int i = 0; i < eventCnt; ++i)
         {
             int sockfd = m_epoller->getEventFd(i);
             uint32_t events = m_epoller->getEvents(i);
 
-            if(sockfd == m_listenFd)
+            if(sockfd == m_listenFd || sockfd == m_unixFd)
+            {
+                dealListen(sockfd);
+            }
+            else if(sockfd == m_completions->fd())
             {
-                dealListen();
+                m_completions->clearSignal();
+            }
+            else if(sockfd == m_upgrader->signalFd())
+            {
+                startUpgrade();
+            }
+            else if(sockfd == m_upgrader->channelFd())
+            {
+                dealUpgradeChannel();
+            }
+            else if(m_asyncDb && dealDbEvent(sockfd, events))
+            {
+                continue;
             }
             else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
             {
@@ -104,170 +461,889 @@ void Webserver::run()
 #endif  
             }
         }
+
+        // 本轮分发中和 epoll_wait 期间工作线程交回的连接，统一在这里处理
+        drainCompletions();
+
+        Metrics::observe(Metrics::LOOP_EVENTS, eventCnt > 0 ? eventCnt : 0);
+        Metrics::observe(Metrics::LOOP_DISPATCH, Metrics::nowUs() - busySince);
+        if(eventCnt == m_epoller->maxEvents())
+        {
+            Metrics::inc(Metrics::LOOP_SATURATED);
+        }
+    }
+}
+
+int Webserver::pollEvents(int timeMS)
+{
+    // 零超时轮询到有事件或预算用完，不超过下一个定时器的时间
+    if(m_busyPoll > 0 && timeMS != 0)
+    {
+        uint64_t budget = m_busyPoll;
+        if(timeMS > 0)
+        {
+            budget = std::min<uint64_t>(budget, static_cast<uint64_t>(timeMS) * 1000);
+        }
+
+        uint64_t start = Metrics::nowUs();
+        do
+        {
+            int eventCnt = m_epoller->wait(0);
+            if(eventCnt != 0)
+            {
+                Metrics::inc(Metrics::BUSY_POLL_HITS);
+                return eventCnt;
+            }
+        } while(Metrics::nowUs() - start < budget);
+        Metrics::inc(Metrics::BUSY_POLL_SLEEPS);
+    }
+
+    return m_epoller->wait(timeMS);
+}
+
+void Webserver::initKeepAlive()
+{
+    // 未配置时沿用 -t 的连接超时；定时器关闭时不限空闲时间
+    if(m_keepAliveTimeout <= 0)
+    {
+        m_keepAliveTimeout = std::max(m_timeout, 0);
+    }
+    if(m_timeout <= 0)
+    {
+        m_keepAliveTimeout = 0;
+    }
+    m_keepAliveMinTimeout = std::min(std::max(m_keepAliveMinTimeout, 1000), m_keepAliveTimeout);
+    m_keepAliveMax = std::max(m_keepAliveMax, 0);
+    m_keepAliveLow = std::min(std::max(m_keepAliveLow, 0), 100);
+    m_keepAliveHigh = std::min(std::max(m_keepAliveHigh, m_keepAliveLow + 1), 101);
+
+    // 可用的连接数：fd 上限扣掉监听、日志、数据库等占用的余量
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+    {
+        m_connCapacity = std::min<int>(MAX_FD, std::max<int>(static_cast<int>(rl.rlim_cur) - FD_RESERVE, 1));
+    }
+
+    HttpConn::keepAliveMax.store(m_keepAliveMax, std::memory_order_relaxed);
+    HttpConn::keepAliveTimeout.store(m_keepAliveTimeout, std::memory_order_relaxed);
+}
+
+size_t Webserver::residentBytes()
+{
+    // statm 第二列为常驻页数
+    std::ifstream ifs("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    ifs >> size >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void Webserver::updateKeepAlive(uint64_t nowUs)
+{
+    // 压力取连接数和内存中较高的一方（百分比）
+    int pressure = static_cast<int>(static_cast<int64_t>(HttpConn::userCount.load()) * 100 / m_connCapacity);
+    if(m_memoryLimit > 0)
+    {
+        if(nowUs - m_rssCheckUs >= RSS_CHECK_US)
+        {
+            m_rssCheckUs = nowUs;
+            m_memPressure = static_cast<int>(residentBytes() * 100 / (static_cast<size_t>(m_memoryLimit) << 20));
+        }
+        pressure = std::max(pressure, m_memPressure);
+    }
+
+    /**
+     *  低水位以下按配置保持连接；高水位以上不再保持（Connection: close）；
+     *  两者之间请求数上限和空闲超时按压力线性收缩
+     */
+    int max = m_keepAliveMax;
+    int timeout = m_keepAliveTimeout;
+    if(pressure >= m_keepAliveHigh)
+    {
+        max = 0;
+        timeout = m_keepAliveMinTimeout;
+    }
+    else if(pressure > m_keepAliveLow)
+    {
+        int span = m_keepAliveHigh - m_keepAliveLow;
+        int left = m_keepAliveHigh - pressure;
+        max = std::max(2, m_keepAliveMax * left / span);
+        timeout = m_keepAliveMinTimeout + (m_keepAliveTimeout - m_keepAliveMinTimeout) * left / span;
+    }
+
+    HttpConn::keepAliveMax.store(max, std::memory_order_relaxed);
+    HttpConn::keepAliveTimeout.store(timeout, std::memory_order_relaxed);
+}
+
+void Webserver::startUpgrade()
+{
+    m_upgrader->clearSignal();
+    if(m_draining || m_upgrader->inProgress())
+    {
+        LOG_WARN("upgrade already in progress, SIGUSR2 ignored");
+        return;
+    }
+
+    std::vector<int> fds = { m_listenFd };
+    if(m_unixFd >= 0)
+    {
+        fds.push_back(m_unixFd);
+    }
+    if(m_upgrader->start(fds))
+    {
+        m_epoller->addFd(m_upgrader->channelFd(), EPOLLIN);
+    }
+}
+
+void Webserver::dealUpgradeChannel()
+{
+    int fd = m_upgrader->channelFd();
+    Upgrader::RESULT ret = m_upgrader->onChannel();
+    if(ret == Upgrader::PENDING)
+    {
+        return;
+    }
+
+    m_epoller->removeFd(fd);
+    if(ret == Upgrader::READY)
+    {
+        beginDrain();
+    }
+}
+
+void Webserver::beginDrain()
+{
+    // 新进程已在同一个套接字上 accept，这里关闭后全连接队列中的连接都由它接受
+    m_epoller->removeFd(m_listenFd);
+    close(m_listenFd);
+    m_listenFd = -1;
+    if(m_unixFd >= 0)
+    {
+        m_epoller->removeFd(m_unixFd);
+        close(m_unixFd);
+        m_unixFd = -1;
+    }
+
+    // 之后的响应都带 Connection: close，客户端收到后改连新进程
+    m_draining = true;
+    HttpConn::draining.store(true, std::memory_order_relaxed);
+    m_drainDeadlineUs = Metrics::nowUs() + static_cast<uint64_t>(std::max(m_upgradeDrain, 0)) * 1000;
+    LOG_INFO("upgrade: stop accepting, draining %d connections", HttpConn::userCount.load());
+}
+
+void Webserver::checkDrain()
+{
+    uint64_t now = Metrics::nowUs();
+    uint64_t idleUs = static_cast<uint64_t>(std::max(m_upgradeIdleClose, 0)) * 1000;
+
+    // 空闲一段时间仍未发来请求的长连接直接关闭；刚发完响应的连接留一点时间，避免与客户端的下一个请求竞争
+    for(auto& item : m_users)
+    {
+        HttpConn* client = &item.second;
+        if(!client->isClosed() && !client->inWorker() && client->stage() == HttpConn::STAGE_IDLE
+            && now - client->stageStartUs() >= idleUs)
+        {
+            closeConn(client);
+        }
+    }
+
+    if(HttpConn::userCount == 0 || now >= m_drainDeadlineUs)
+    {
+        LOG_INFO("upgrade: drained, %d connections left, exiting", HttpConn::userCount.load());
+        m_isClose = true;
+    }
+}
+
+string Webserver::makeRejectResponse(const char* status, const char* body, int retryAfter)
+{
+    string response = string("HTTP/1.1 ") + status + "\r\n";
+    response += "Retry-After: " + std::to_string(std::max(retryAfter, 0)) + "\r\n";
+    response += "Content-Type: text/plain\r\n";
+    response += "Content-Length: " + std::to_string(strlen(body)) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    return response;
+}
+
+void Webserver::initRejectResponses()
+{
+    m_busyResponse = makeRejectResponse("503 Service Unavailable", "Server is overloaded, please retry later.\n", m_retryAfter);
+    m_limitResponse = makeRejectResponse("429 Too Many Requests", "Too many requests from your address.\n", m_retryAfter);
+}
+
+void Webserver::sendReject(int fd, int code)
+{
+    assert(fd > 0);
+    // 先读掉已到达的请求：带着未读数据 close 会发 RST，客户端可能收不到响应
+    char buf[4096];
+    for(int i = 0; i < 16 && recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0; ++i)
+    {
+    }
+
+    const string& response = code == 429 ? m_limitResponse : m_busyResponse;
+    int len = send(fd, response.data(), response.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if(len < 0)
+    {
+#ifdef DEBUG
+        std::cout << "send " << code << " to client[" << fd  << "] error" << std::endl;
+#endif 
+    }
+    Metrics::status(code);
+}
+
+void Webserver::shedConn(HttpConn* client, Metrics::COUNTER reason, int code)
+{
+    assert(client);
+    Metrics::inc(reason);
+    sendReject(client->getFd(), code);
+    closeConn(client);
+}
+
+void Webserver::closeConn(HttpConn* client)
+{
+    assert(client);
+    m_epoller->removeFd(client->getFd());
+    if(!client->isClosed() && client->ipCounted())
+    {
+        m_ipLimiter->releaseConn(client->getAddr());
+    }
+    client->closeConn();
+#ifdef DEBUG
+        std::cout << "close client [" << client->getFd() << "] connection." << std::endl;
+#endif 
+}
+
+void Webserver::addClnt(int fd, const sockaddr_storage& addr, bool ipCounted)
+{
+    assert(fd > 0);
+    m_users[fd].init(fd, addr);
+    m_users[fd].setIpCounted(ipCounted);
+    m_users[fd].setNode(CpuAffinity::getInstance()->incomingNode(fd));
+    if(m_busyPoll > 0 && m_busyPollSocket > 0 && addr.ss_family != AF_UNIX)
+    {
+        // 阻塞读写和 epoll 都先轮询网卡队列；超过 net.core.busy_read 需要 CAP_NET_ADMIN，失败后不再设置
+        int prefer = 1;
+        if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &m_busyPollSocket, sizeof(m_busyPollSocket)) < 0)
+        {
+            LOG_WARN("SO_BUSY_POLL %d failed: %s, disabled", m_busyPollSocket, strerror(errno));
+            m_busyPollSocket = 0;
+        }
+        else
+        {
+            setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer));
+        }
+    }
+    if(m_timeout > 0)
+    {
+        // 添加定时器
+        m_timer->add(fd, std::max(remainingMs(&m_users[fd]), 1), [this, fd]{ onExpire(fd); });
+    }
+
+    m_epoller->addFd(fd, EPOLLIN | m_clntEvent);
+#ifdef DEBUG
+        std::cout << "add client [" << fd << "] connection." << std::endl;
+#endif 
+}
+
+void Webserver::dealListen(int listenFd)
+{
+    // TCP 和 Unix 域监听套接字共用同一条接受路径
+    struct sockaddr_storage addr;
+    socklen_t len;
+
+    // 边缘触发必须取到 EAGAIN；水平触发分批接受，避免连接风暴饿死已有连接
+    int budget = (m_listenEvent & EPOLLET) ? INT_MAX : m_acceptBatch;
+    for(int i = 0; i < budget; ++i)
+    {
+        len = sizeof(addr);
+        int fd = accept4(listenFd, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if((errno == EMFILE || errno == ENFILE) && dropWithReserveFd(listenFd))
+            {
+                continue;
+            }
+            return;
+        }
+        else if(HttpConn::userCount >= MAX_FD)
+        {
+            LOG_WARN("too many connections (%d), reject client", HttpConn::userCount.load());
+            Metrics::inc(Metrics::SHED_CONN_LIMIT);
+            sendReject(fd, 503);
+            close(fd);
+            continue;
+        }
+
+        // 按来源 IP 限流，在初始化连接之前拒绝
+        bool ipCounted;
+        IpLimiter::RESULT limit = m_ipLimiter->acquireConn(addr, Metrics::nowUs(), &ipCounted);
+        if(__builtin_expect(limit != IpLimiter::PASS, 0))
+        {
+            Metrics::inc(limit == IpLimiter::CONN_LIMIT ? Metrics::IP_CONN_LIMIT : Metrics::IP_CONN_RATE);
+            sendReject(fd, 429);
+            close(fd);
+            continue;
+        }
+
+        Metrics::inc(Metrics::ACCEPTS);
+        addClnt(fd, addr, ipCounted);
+    }
+}
+
+/**
+ *  进程 fd 耗尽时 accept 失败但连接仍留在队列里，监听 fd 一直可读，水平触发下事件循环会空转。
+ *  关闭预留 fd 腾出一个位置，取出一个连接回 503 后关闭，再重新占住预留 fd
+ */
+bool Webserver::dropWithReserveFd(int listenFd)
+{
+    if(m_reserveFd < 0)
+    {
+        return false;
+    }
+
+    close(m_reserveFd);
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if(fd >= 0)
+    {
+        Metrics::inc(Metrics::ACCEPT_EMFILE);
+        sendReject(fd, 503);
+        close(fd);
+    }
+    m_reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    return fd >= 0;
+}
+
+void Webserver::dealRead(HttpConn* client)
+{
+    assert(client);
+    // 追踪关闭时只有这一处可预测的分支，之后各阶段的 id 都为 0
+    if(__builtin_expect(Trace::active(), 0))
+    {
+        client->setTraceId(Trace::sample());
+    }
+    TraceScope trace(client->traceId(), Trace::DISPATCH_READ);
+    // 空闲连接有数据到达，请求头阶段从此刻开始计时
+    if(client->stage() == HttpConn::STAGE_IDLE)
+    {
+        client->enterStage(HttpConn::STAGE_HEADER);
+    }
+    if(!extentTime(client))
+    {
+        return;
+    }
+    client->setTraceQueuedUs(trace.startUs());
+
+    // 反应堆 I/O 模式：非阻塞读在反应堆完成，读多少取决于对端，不占用工作线程
+    // 就地处理请求时也要先读进来才能判断
+    if((m_reactorIo || m_inlineRequests) && !readInReactor(client))
+    {
+        return;
+    }
+
+    // 按来源 IP 的请求速率，以读事件计（流水线中的多个请求算一次）
+    if(__builtin_expect(m_ipLimiter->allowRequest(client->getAddr(), Metrics::nowUs()) != IpLimiter::PASS, 0))
+    {
+        shedConn(client, Metrics::IP_REQ_RATE, 429);
+        return;
+    }
+
+    if(processInline(client))
+    {
+        return;
+    }
+
+    // 新请求走准入：过载时由反应堆直接回 503，不再进入队列
+    // 已在反应堆读入时线程池只负责解析和生成响应
+    ThreadsPool::ADMIT ret = m_threadsPool->admitTask(m_reactorIo || m_inlineRequests
+        ? std::bind(&Webserver::onProcessTask, this, client)
+        : std::bind(&Webserver::onRead, this, client), client->node());
+    if(__builtin_expect(ret != ThreadsPool::ADMIT_OK, 0))
+    {
+        shedConn(client, ret == ThreadsPool::ADMIT_QUEUE_FULL ? Metrics::SHED_QUEUE_FULL : Metrics::SHED_OVERLOAD, 503);
+        return;
+    }
+    client->setInWorker(true);
+}
+
+void Webserver::dealWrite(HttpConn* client)
+{
+    assert(client);
+    TraceScope trace(client->traceId(), Trace::DISPATCH_WRITE);
+    if(!extentTime(client))
+    {
+        return;
+    }
+    client->setTraceQueuedUs(trace.startUs());
+
+    if(m_reactorIo)
+    {
+        if(handleWrite(client, true))
+        {
+            dispatchPending(client);
+        }
+        return;
+    }
+
+    // 线程池添加任务
+    client->setInWorker(true);
+    m_threadsPool->addTask(std::bind(&Webserver::onWrite, this, client), client->node());
+}
+
+bool Webserver::readInReactor(HttpConn* client)
+{
+    int readErrno = 0;
+    ssize_t ret;
+    // 反应堆读写时缓冲区由反应堆线程首次访问；只有连接所属节点与反应堆所在节点一致时才会迁移
+    client->bindMemory();
+    {
+        TraceScope trace(client->traceId(), Trace::READ);
+        ret = client->readFromClnt(&readErrno);
+    }
+
+    // ret == 0 表示对端已关闭
+    if(ret == 0 || (ret < 0 && readErrno != EAGAIN))
+    {
+        closeConn(client);
+        return false;
+    }
+    return true;
+}
+
+bool Webserver::processInline(HttpConn* client)
+{
+    // 只在反应堆上处理不访问数据库的请求，登录/注册仍交给线程池
+    if(!m_inlineRequests || !client->isCheap())
+    {
+        return false;
+    }
+
+    // 流水线中的请求循环处理，每次分发最多 INLINE_BUDGET 个，避免一个连接长时间占住反应堆
+    int budget = INLINE_BUDGET;
+    do
+    {
+        Metrics::inc(Metrics::INLINE_REQUESTS);
+        bool ready;
+        {
+            TraceScope trace(client->traceId(), Trace::PROCESS);
+            ready = client->process();
+        }
+        if(!ready)
+        {
+            applyCompletion(client, CompletionQueue::REARM_READ);
+            return true;
+        }
+        if(!handleWrite(client, true))
+        {
+            return true;
+        }
+    } while(client->pendingBytes() > 0 && client->isCheap() && --budget > 0);
+
+    requeuePending(client);
+    return true;
+}
+
+void Webserver::dispatchPending(HttpConn* client)
+{
+    if(client->pendingBytes() > 0 && processInline(client))
+    {
+        return;
+    }
+    requeuePending(client);
+}
+
+void Webserver::requeuePending(HttpConn* client)
+{
+    if(client->pendingBytes() > 0)
+    {
+        // 流水线中还有请求，交给线程池解析；读缓冲区里已有数据，边沿触发下重新注册读事件等不到通知
+        client->setInWorker(true);
+        m_threadsPool->addTask(std::bind(&Webserver::onProcessTask, this, client), client->node());
+    }
+    else
+    {
+        applyCompletion(client, CompletionQueue::REARM_READ);
+    }
+}
+
+bool Webserver::extentTime(HttpConn* client)
+{
+    assert(client);
+    if(m_timeout > 0)
+    {
+        // 按当前阶段的截止时间调整，已经超时的直接关闭
+        int remain = remainingMs(client);
+        if(remain == 0)
+        {
+            expireConn(client);
+            return false;
+        }
+        m_timer->adjust(client->getFd(), remain);
+    }
+    return true;
+}
+
+int Webserver::remainingMs(const HttpConn* client) const
+{
+    const StagePolicy& policy = m_stagePolicy[client->stage()];
+    // 空闲阶段以响应中通告给该连接的超时为准
+    int timeout = client->stage() == HttpConn::STAGE_IDLE ? client->keepAliveMs() : policy.timeout;
+
+    uint64_t allowUs = static_cast<uint64_t>(std::max(timeout, 0)) * 1000;
+    if(policy.minRate > 0)
+    {
+        allowUs += client->stageBytes() * 1000000 / policy.minRate;
+    }
+    if(policy.maxTimeout > 0)
+    {
+        allowUs = std::min<uint64_t>(allowUs, static_cast<uint64_t>(policy.maxTimeout) * 1000);
+    }
+
+    uint64_t deadline = client->stageStartUs() + allowUs;
+    uint64_t now = Metrics::nowUs();
+    return deadline > now ? static_cast<int>((deadline - now + 999) / 1000) : 0;
+}
+
+void Webserver::onExpire(int fd)
+{
+    HttpConn* client = &m_users[fd];
+    if(client->isClosed())
+    {
+        return;
     }
-}
 
-void Webserver::sendError(int fd, const char* info)
-{
-    assert(fd > 0);
-    int len = send(fd, info, strlen(info), 0);
-    if(len < 0)
+    // 定时器按上次分发时的阶段设置，到期时阶段可能已经变化，重新计算
+    int remain = remainingMs(client);
+    if(remain > 0)
     {
-#ifdef DEBUG
-        std::cout << "send error to client[" << fd  << "]"<< std::endl;
-#endif 
-    } 
-    close(fd);
+        m_timer->add(fd, remain, [this, fd]{ onExpire(fd); });
+        return;
+    }
+
+    // 工作线程还持有连接，不能在这里释放，交回时再关闭
+    if(client->inWorker())
+    {
+        client->setExpirePending(true);
+        return;
+    }
+    expireConn(client);
 }
 
-void Webserver::closeConn(HttpConn* client)
+void Webserver::expireConn(HttpConn* client)
 {
-    assert(client);
-    m_epoller->removeFd(client->getFd());
-    client->closeConn();
-#ifdef DEBUG
-        std::cout << "close client [" << client->getFd() << "] connection." << std::endl;
-#endif 
+    static const Metrics::COUNTER REASON[HttpConn::STAGE_NUM] =
+    {
+        Metrics::TIMER_EXPIRED, Metrics::SLOW_HEADER, Metrics::SLOW_BODY, Metrics::TIMER_EXPIRED, Metrics::SLOW_DRAIN,
+    };
+
+    HttpConn::STAGE stage = client->stage();
+    Metrics::inc(REASON[stage]);
+
+    if(REASON[stage] != Metrics::TIMER_EXPIRED)
+    {
+        // 慢速客户端直接 RST：丢弃未发送的数据，不在 FIN_WAIT 中占用内核缓冲区
+        struct linger optLinger = { 1, 0 };
+        setsockopt(client->getFd(), SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    }
+    closeConn(client);
 }
 
-void Webserver::addClnt(int fd, sockaddr_in addr)
+void Webserver::recordQueue(HttpConn* client)
 {
-    assert(fd > 0);
-    m_users[fd].init(fd, addr);
-    if(m_timeout > 0)
+    uint32_t traceId = client->traceId();
+    if(__builtin_expect(traceId != 0, 0))
     {
-        // 添加定时器
-        m_timer->add(fd, m_timeout, std::bind(&Webserver::closeConn, this, &m_users[fd]));
+        Trace::record(traceId, Trace::QUEUE, client->traceQueuedUs(), Metrics::nowUs());
     }
-
-    m_epoller->addFd(fd, EPOLLIN | m_clntEvent);
-    setnoblock(fd);
-#ifdef DEBUG
-        std::cout << "add client [" << fd << "] connection." << std::endl;
-#endif 
 }
 
-void Webserver::dealListen()
+void Webserver::onRead(HttpConn* client)
 {
-    struct sockaddr_in addr;
-    socklen_t len = sizeof(addr);
+    assert(client);
+    int ret = -1;
+    int readErrno = 0;
+
+    recordQueue(client);
+    client->bindMemory();
 
-    do
     {
-        int fd = accept(m_listenFd, (struct sockaddr*)&addr, &len);
-        if(fd < 0)
-        {
-            return;
-        }
-        else if(HttpConn::userCount >= MAX_FD)
-        {
-            sendError(fd, "Server busy!");
-            return;
-        }
+        TraceScope trace(client->traceId(), Trace::READ);
+        ret = client->readFromClnt(&readErrno);
+    }
 
-        addClnt(fd, addr);
+    // ret == 0 表示对端已关闭
+    if(ret == 0 || (ret < 0 && readErrno != EAGAIN))
+    {
+        complete(client, CompletionQueue::CLOSE, false);
+        return;
+    }
 
-    } while (m_listenEvent & EPOLLET);
-    
+    onProcess(client);
 }
 
-void Webserver::dealRead(HttpConn* client)
+void Webserver::onProcessTask(HttpConn* client)
 {
     assert(client);
-    extentTime(client);
+    recordQueue(client);
+    onProcess(client);
+}
 
-    // 线程池添加任务
-    m_threadsPool->addTask(std::bind(&Webserver::onRead, this, client));
+void Webserver::onProcess(HttpConn* client)
+{
+    TraceScope trace(client->traceId(), Trace::PROCESS);
+    bool ready = client->process();
+
+    // 只有推迟了数据库校验的登录/注册进入协程，静态资源等请求同步完成
+    if(client->needVerify())
+    {
+        onVerifyAsync(client);
+        return;
+    }
+
+    complete(client, ready ? CompletionQueue::REARM_WRITE : CompletionQueue::REARM_READ, false);
 }
 
-void Webserver::dealWrite(HttpConn* client)
+Detached Webserver::onVerifyAsync(HttpConn* client)
 {
-    assert(client);
-    extentTime(client);
-    // 线程池添加任务
-    m_threadsPool->addTask(std::bind(&Webserver::onWrite, this, client));
+    co_await client->verifyAsync();
+    complete(client, CompletionQueue::REARM_WRITE, false);
 }
 
-void Webserver::extentTime(HttpConn* client)
+void Webserver::watch(int fd, uint32_t events, std::coroutine_handle<> h, uint32_t* revents, int timeoutMs)
 {
-    assert(client);
-    if(m_timeout > 0)
+    std::lock_guard<std::mutex> locker(m_dbWatchMtx);
+    DbWatch& w = m_dbWatches[fd];
+    w.handle = h;
+    w.revents = revents;
+    w.deadlineUs = timeoutMs > 0 ? Metrics::nowUs() + static_cast<uint64_t>(timeoutMs) * 1000 : 0;
+
+    // 一次性事件，每次挂起重新注册
+    if(w.added)
     {
-        // 调整时间
-        m_timer->adjust(client->getFd(), m_timeout);
+        m_epoller->modFd(fd, events | EPOLLONESHOT);
+    }
+    else
+    {
+        w.added = m_epoller->addFd(fd, events | EPOLLONESHOT);
+    }
+
+    // 反应堆可能正阻塞在更晚的超时上，唤醒它重新计算等待时间
+    if(w.deadlineUs)
+    {
+        m_completions->wakeup();
     }
 }
 
-void Webserver::onRead(HttpConn* client)
+void Webserver::unwatch(int fd)
 {
-    assert(client);
-    int ret = -1;
-    int readErrno = 0;
+    std::lock_guard<std::mutex> locker(m_dbWatchMtx);
+    auto it = m_dbWatches.find(fd);
+    if(it == m_dbWatches.end())
+    {
+        return;
+    }
+
+    if(it->second.added)
+    {
+        m_epoller->removeFd(fd);
+    }
+    m_dbWatches.erase(it);
+}
 
-    ret = client->readFromClnt(&readErrno);
+void Webserver::post(std::coroutine_handle<> h)
+{
+    m_threadsPool->addTask([h]{ h.resume(); });
+}
 
-    if(ret < 0 && readErrno != EAGAIN)
+bool Webserver::dealDbEvent(int fd, uint32_t events)
+{
+    std::coroutine_handle<> h;
     {
-        closeConn(client);
+        std::lock_guard<std::mutex> locker(m_dbWatchMtx);
+        auto it = m_dbWatches.find(fd);
+        if(it == m_dbWatches.end())
+        {
+            return false;
+        }
 
-        return;
+        if(!it->second.handle)
+        {
+            return true;
+        }
+        h = it->second.handle;
+        *it->second.revents = events;
+        it->second.handle = nullptr;
     }
 
-    onProcess(client);
+    post(h);
+    return true;
 }
 
-void Webserver::onProcess(HttpConn* client)
+int Webserver::checkDbTimeouts()
 {
-    if(client->process())
+    // 到期的等待以 revents = 0 恢复，协程按 MYSQL_WAIT_TIMEOUT 处理；返回距最近截止时间的毫秒数，没有为 -1
+    std::vector<std::coroutine_handle<>> expired;
+    uint64_t nextUs = 0;
     {
-        m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLOUT);
+        std::lock_guard<std::mutex> locker(m_dbWatchMtx);
+        uint64_t now = Metrics::nowUs();
+        for(auto& it : m_dbWatches)
+        {
+            DbWatch& w = it.second;
+            if(!w.handle || w.deadlineUs == 0)
+            {
+                continue;
+            }
+
+            if(w.deadlineUs <= now)
+            {
+                // 仍是一次性监听，之后迟到的事件找不到协程会被忽略
+                *w.revents = 0;
+                expired.push_back(w.handle);
+                w.handle = nullptr;
+            }
+            else if(nextUs == 0 || w.deadlineUs - now < nextUs)
+            {
+                nextUs = w.deadlineUs - now;
+            }
+        }
     }
-    else
+
+    for(std::coroutine_handle<> h : expired)
     {
-        m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLIN);
+        post(h);
     }
+    return nextUs ? static_cast<int>((nextUs + 999) / 1000) : -1;
 }
 
 void Webserver::onWrite(HttpConn* client)
 {
     assert(client);
+    recordQueue(client);
+    handleWrite(client, false);
+}
+
+bool Webserver::handleWrite(HttpConn* client, bool inReactor)
+{
     int ret = -1;
     int writeErrno = 0;
 
-    ret = client->writeToClnt(&writeErrno);
+    {
+        TraceScope trace(client->traceId(), Trace::WRITE);
+        ret = client->writeToClnt(&writeErrno);
+    }
     if(client->toWriteBytes() == 0)
     {
         /* 传输完成 */
         if(client->isKeepAlive())
         {
+            // 反应堆上由调用方继续处理流水线中的请求，这里不再递归
+            if(inReactor)
+            {
+                return true;
+            }
             onProcess(client);
-            return;
+            return false;
         }
     }
     else if(ret < 0)
     {
         if(writeErrno == EAGAIN)
         {
-            m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLOUT);
-            return;
+            // 发送缓冲区满，等待 EPOLLOUT；反应堆 I/O 模式下 REARM_WRITE 表示立即重写，这里直接注册
+            if(inReactor)
+            {
+                m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLOUT);
+            }
+            else
+            {
+                complete(client, CompletionQueue::REARM_WRITE, false);
+            }
+            return false;
         }
     }
 
-    closeConn(client);
+    complete(client, CompletionQueue::CLOSE, inReactor);
+    return false;
 }
 
-bool Webserver::initSocket()
+void Webserver::complete(HttpConn* client, CompletionQueue::OP op, bool inReactor)
 {
-    int ret;
-    struct sockaddr_in addr;
+    if(inReactor)
+    {
+        applyCompletion(client, op);
+    }
+    else
+    {
+        m_completions->post(client, op);
+    }
+}
 
-    if(m_port > 65535 || m_port < 1024)
+void Webserver::applyCompletion(HttpConn* client, CompletionQueue::OP op)
+{
+    client->setInWorker(false);
+    if(client->isClosed())
     {
-#ifdef DEBUG
-        std::cout << "Port:" << m_port << "error!" << std::endl;
-#endif
-        return false;
+        return;
+    }
+    if(client->expirePending())
+    {
+        client->setExpirePending(false);
+        expireConn(client);
+        return;
+    }
+
+    switch(op)
+    {
+    case CompletionQueue::REARM_READ:
+        if(client->stage() == HttpConn::STAGE_DRAIN)
+        {
+            client->enterStage(HttpConn::STAGE_IDLE);
+        }
+        // 定时器还是发送阶段的截止时间，按空闲（或请求头）阶段重新设置
+        if(!extentTime(client))
+        {
+            return;
+        }
+        m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLIN);
+        break;
+    case CompletionQueue::REARM_WRITE:
+        if(m_reactorIo)
+        {
+            // 响应刚生成，套接字通常可写：直接写，省一次 epoll_ctl 和 epoll_wait
+            dealWrite(client);
+        }
+        else
+        {
+            m_epoller->modFd(client->getFd(), m_clntEvent | EPOLLOUT);
+        }
+        break;
+    case CompletionQueue::CLOSE:
+        closeConn(client);
+        break;
+    }
+}
+
+void Webserver::drainCompletions()
+{
+    size_t n = m_completions->drain([this](const CompletionQueue::Completion& c)
+    {
+        applyCompletion(c.client, c.op);
+    });
+    if(n > 0)
+    {
+        Metrics::inc(Metrics::COMPLETIONS, n);
+        Metrics::observe(Metrics::LOOP_COMPLETIONS, n);
     }
+}
+
+bool Webserver::openListenSocket()
+{
+    int ret;
+    struct sockaddr_in addr;
 
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -281,7 +1357,7 @@ bool Webserver::initSocket()
         optLinger.l_linger = 1;
     }
 
-    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    m_listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if(m_listenFd < 0)
     {
 #ifdef DEBUG
@@ -301,6 +1377,18 @@ bool Webserver::initSocket()
         return false;
     }
 
+    /* 端口复用: 重启时不受残留 TIME_WAIT 连接影响 */
+    int optval = 1;
+    ret = setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    if(ret < 0)
+    {
+        close(m_listenFd);
+#ifdef DEBUG
+        std::cout << "set socket setsockopt error !" << std::endl;
+#endif
+        return false;
+    }
+
     ret = bind(m_listenFd, (struct sockaddr*)&addr, sizeof(addr));
     if(ret < 0)
     {
@@ -311,7 +1399,19 @@ bool Webserver::initSocket()
         return false;
     }
 
-    ret = listen(m_listenFd, 6);
+    /* 三次握手后有数据到达才唤醒 accept，只连不发的连接不占用 HttpConn */
+    if(m_deferAccept > 0 && setsockopt(m_listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &m_deferAccept, sizeof(m_deferAccept)) < 0)
+    {
+        LOG_WARN("set TCP_DEFER_ACCEPT failed: %s", strerror(errno));
+    }
+
+    /* TCP Fast Open：回访客户端的请求随 SYN 一起到达，省一个往返 */
+    if(m_fastOpen > 0 && setsockopt(m_listenFd, IPPROTO_TCP, TCP_FASTOPEN, &m_fastOpen, sizeof(m_fastOpen)) < 0)
+    {
+        LOG_WARN("set TCP_FASTOPEN failed: %s", strerror(errno));
+    }
+
+    ret = listen(m_listenFd, m_backlog);
     if(ret < 0)
     {
         close(m_listenFd);
@@ -321,7 +1421,118 @@ bool Webserver::initSocket()
         return false;
     }
 
-    ret = m_epoller->addFd(m_listenFd, m_listenEvent | EPOLLIN);
+    return true;
+}
+
+bool Webserver::openUnixSocket()
+{
+    struct sockaddr_un addr;
+    if(m_unixPath.size() >= sizeof(addr.sun_path))
+    {
+        LOG_ERROR("unix socket path too long: %s", m_unixPath.c_str());
+        return false;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, m_unixPath.c_str(), m_unixPath.size() + 1);
+
+    m_unixFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(m_unixFd < 0)
+    {
+        return false;
+    }
+
+    // 上次异常退出留下的套接字文件会让 bind 失败；先试连一次，只有确认没有进程在监听才删除
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(probe < 0)
+    {
+        close(m_unixFd);
+        m_unixFd = -1;
+        return false;
+    }
+    int ret = connect(probe, (struct sockaddr*)&addr, sizeof(addr));
+    int err = ret < 0 ? errno : 0;
+    close(probe);
+
+    struct stat st;
+    if(err == ECONNREFUSED && lstat(m_unixPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        unlink(m_unixPath.c_str());
+    }
+    else if(err != ENOENT)
+    {
+        // 连接成功或积压队列已满（EAGAIN）说明另一个实例仍在服务，其余错误也不能贸然删除
+        LOG_ERROR("unix socket %s is in use or not removable: %s", m_unixPath.c_str(),
+            err ? strerror(err) : "listener answered");
+        close(m_unixFd);
+        m_unixFd = -1;
+        return false;
+    }
+
+    if(bind(m_unixFd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+        || chmod(m_unixPath.c_str(), m_unixPerm) < 0
+        || listen(m_unixFd, m_backlog) < 0)
+    {
+        LOG_ERROR("unix socket %s init failed: %s", m_unixPath.c_str(), strerror(errno));
+        close(m_unixFd);
+        m_unixFd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+bool Webserver::initSocket()
+{
+    int ret;
+
+    if(m_port > 65535 || m_port < 1024)
+    {
+#ifdef DEBUG
+        std::cout << "Port:" << m_port << "error!" << std::endl;
+#endif
+        return false;
+    }
+
+    // 热升级启动：监听套接字由旧进程交来，已经 bind、listen 并设置好选项
+    for(int fd : m_upgrader->inheritListenFds())
+    {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (struct sockaddr*)&addr, &len);
+        if(addr.ss_family == AF_INET && m_listenFd < 0)
+        {
+            m_listenFd = fd;
+        }
+        else if(addr.ss_family == AF_UNIX && m_unixFd < 0
+            && m_unixPath == reinterpret_cast<struct sockaddr_un*>(&addr)->sun_path)
+        {
+            m_unixFd = fd;
+        }
+        else
+        {
+            close(fd);
+        }
+    }
+
+    if(m_listenFd < 0 && !openListenSocket())
+    {
+        return false;
+    }
+    if(!m_unixPath.empty() && m_unixFd < 0 && !openUnixSocket())
+    {
+        close(m_listenFd);
+        return false;
+    }
+
+    ret = m_epoller->addFd(m_listenFd, m_listenEvent | EPOLLIN)
+        && m_epoller->addFd(m_completions->fd(), EPOLLIN)
+        && m_epoller->addFd(m_upgrader->signalFd(), EPOLLIN);
+    if(ret && m_unixFd >= 0)
+    {
+        ret = m_epoller->addFd(m_unixFd, m_listenEvent | EPOLLIN);
+    }
     if(ret == 0)
     {
         close(m_listenFd);
@@ -332,11 +1543,19 @@ bool Webserver::initSocket()
     }
 
     setnoblock(m_listenFd);
+
+    // 低延迟模式：网卡支持时 epoll_wait 在内核中轮询收包队列
+    if(m_busyPoll > 0 && m_busyPollSocket > 0 && !m_epoller->setBusyPoll(m_busyPollSocket, true))
+    {
+        LOG_INFO("epoll busy poll unavailable: %s", strerror(errno));
+    }
+
+    m_reserveFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
     return true;
 }
 
 int Webserver::setnoblock(int fd)
 {
     assert(fd > 0);
-    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFD, 0) | O_NONBLOCK);
+    return fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
 }
\ No newline at end of file
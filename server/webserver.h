@@ -3,47 +3,109 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <signal.h>
 #include <assert.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unordered_map>
+#include <mutex>
+#include <coroutine>
+#include <fstream>
+#include <algorithm>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <netinet/tcp.h>
+#include <climits>
 
 #include "epoller.h"
+#include "watchdog.h"
+#include "ipLimiter.h"
+#include "completionQueue.h"
+#include "upgrader.h"
 #include "../http/httpConn.h"
 #include "../timer/minHeapTimer.h"
 #include "../pool/sqlConnsPool/dbConnsPool.h"
 #include "../pool/threadsPool/threadsPool.h"
 #include "../utils/pathInfo.h"
+#include "../utils/coTask.h"
+#include "../utils/cpuAffinity.h"
+#include "../metrics/metrics.h"
+#include "../log/log.h"
 
 
-class Webserver
+class Webserver : public IoWatcher
 {
 public:
-    Webserver(int port, int trigMode, int timeoutMS, bool optLinger);
+    Webserver(int port, int trigMode, int timeoutMS, bool optLinger, const string& unixPath = "");
     ~Webserver();
     void run();
 
+    /* IoWatcher：数据库 socket 由反应堆监听，就绪后在线程池中恢复协程 */
+    void watch(int fd, uint32_t events, std::coroutine_handle<> h, uint32_t* revents, int timeoutMs) override;
+    void unwatch(int fd) override;
+    void post(std::coroutine_handle<> h) override;
+
 private:
     static const int MAX_FD = 65536;
+    static const int DRAIN_CHECK_MS = 100;
+    static const int FD_RESERVE = 64;               // 计算连接容量时为非连接 fd 预留
+    static const uint64_t RSS_CHECK_US = 1000000;   // 内存压力的采样间隔
+    static const int INLINE_BUDGET = 16;            // 反应堆上每次分发最多就地处理的流水线请求数
 
     static int setnoblock(int fd);
 
+    bool loadConfigFile();
     bool initSocket();
     void initEventMode(int trigMode);
-    void addClnt(int fd, sockaddr_in addr);
-
-    void dealListen();
+    void initMetrics();
+    void addClnt(int fd, const sockaddr_storage& addr, bool ipCounted);
+
+    void dealListen(int listenFd);
+    bool openListenSocket();
+    bool openUnixSocket();
+    void initKeepAlive();
+    void updateKeepAlive(uint64_t nowUs);
+    static size_t residentBytes();
+    void startUpgrade();
+    void dealUpgradeChannel();
+    void beginDrain();
+    void checkDrain();
+    bool dropWithReserveFd(int listenFd);
     void dealWrite(HttpConn* client);
     void dealRead(HttpConn* client);
 
-    void sendError(int fd, const char* info);
-    void extentTime(HttpConn* client);
+    static string makeRejectResponse(const char* status, const char* body, int retryAfter);
+    void initRejectResponses();
+    void sendReject(int fd, int code);
+    void shedConn(HttpConn* client, Metrics::COUNTER reason, int code);
+    bool extentTime(HttpConn* client);
+    int remainingMs(const HttpConn* client) const;
+    void onExpire(int fd);
+    void expireConn(HttpConn* client);
     void closeConn(HttpConn* client);
 
+    bool readInReactor(HttpConn* client);
+    bool processInline(HttpConn* client);
+    void dispatchPending(HttpConn* client);
+    void requeuePending(HttpConn* client);
+    int pollEvents(int timeMS);
+    void recordQueue(HttpConn* client);
+
     void onRead(HttpConn* client);
     void onWrite(HttpConn* client);
     void onProcess(HttpConn* client);
+    void onProcessTask(HttpConn* client);
+    bool handleWrite(HttpConn* client, bool inReactor);
+    void complete(HttpConn* client, CompletionQueue::OP op, bool inReactor);
+    void applyCompletion(HttpConn* client, CompletionQueue::OP op);
+    void drainCompletions();
+    Detached onVerifyAsync(HttpConn* client);
+
+    bool dealDbEvent(int fd, uint32_t events);
+    int checkDbTimeouts();
 
     string getResourcesPath();
 
@@ -55,7 +117,65 @@ private:
     bool m_isClose;
 
     int m_listenFd;
+    int m_reserveFd;            // 预留的空闲 fd，fd 耗尽时腾出来接受并关闭连接
     string m_srcDir;
+    string m_configPath;
+
+    int m_stallThreshold;       // 事件循环卡顿阈值（毫秒），0 关闭看门狗
+
+    int m_backlog;              // listen 的全连接队列长度（内核会截断到 somaxconn）
+    int m_acceptBatch;          // 水平触发时每次可读事件最多 accept 的连接数
+    int m_deferAccept;          // TCP_DEFER_ACCEPT 秒数，0 关闭
+    int m_fastOpen;             // TCP Fast Open 队列长度，0 关闭
+
+    /**
+     *  长连接策略：连接数（或内存）占用低于低水位时按配置保持，高于高水位时不再保持，
+     *  之间线性收缩每连接请求数上限和空闲超时；结果经 HttpConn 的静态原子量在生成响应时通告
+     */
+    int m_keepAliveMax;         // 每连接请求数上限
+    int m_keepAliveTimeout;     // 空闲超时（毫秒），0 沿用 -t
+    int m_keepAliveMinTimeout;  // 收缩到的最短空闲超时（毫秒）
+    int m_keepAliveLow;         // 低水位（容量百分比）
+    int m_keepAliveHigh;        // 高水位（容量百分比）
+    int m_memoryLimit;          // 内存上限（MB），0 只看连接数
+    int m_connCapacity;         // 连接容量：min(MAX_FD, RLIMIT_NOFILE - 预留)
+    int m_memPressure;          // 最近一次采样的内存占用百分比
+    uint64_t m_rssCheckUs;
+
+    /* 同机反向代理经 Unix 域套接字接入，省去回环 TCP 的协议栈开销；路径为空不启用 */
+    string m_unixPath;
+    int m_unixPerm;             // 套接字文件权限（八进制）
+    int m_unixFd;
+    int m_retryAfter;           // 503/429 的 Retry-After（秒）
+
+    /**
+     *  半同步/半异步：反应堆做非阻塞读写并负责 EPOLLOUT 续写，线程池只做解析和生成响应，
+     *  工作线程耗时只随请求数增长，与客户端带宽无关。false 时读写也在线程池中完成
+     */
+    bool m_reactorIo;
+
+    /**
+     *  低延迟模式：epoll_wait 阻塞前先零超时轮询 m_busyPoll 微秒，省去睡眠/唤醒的延迟，代价是反应堆空转占满一个 CPU；
+     *  连接设置 SO_BUSY_POLL/SO_PREFER_BUSY_POLL，网卡支持时在内核中轮询收包队列。
+     *  m_inlineRequests 时不访问数据库的请求直接在反应堆上解析和写回，不经线程池
+     */
+    int m_busyPoll;             // 用户态轮询预算（微秒），0 为关闭
+    int m_busyPollSocket;       // SO_BUSY_POLL 和 epoll 内核轮询时长（微秒），0 为不设置
+    bool m_inlineRequests;
+    string m_busyResponse;      // 预先生成的完整 503 响应，反应堆直接发送
+    string m_limitResponse;     // 预先生成的完整 429 响应，按 IP 限流时发送
+
+    /**
+     *  各阶段的截止时间（防慢速攻击）：阶段开始后 timeout 毫秒内必须完成，
+     *  每收发 minRate 字节延长 1 秒，总时长不超过 maxTimeout（0 为不封顶）
+     */
+    struct StagePolicy
+    {
+        int timeout;
+        int maxTimeout;
+        int minRate;
+    };
+    StagePolicy m_stagePolicy[HttpConn::STAGE_NUM];
 
     uint32_t m_listenEvent;     // 监听套接字的 epoll 事件类型（如 EPOLLIN、EPOLLET)
     uint32_t m_clntEvent;       // 客户端连接的 epoll 事件类型（如 EPOLLIN、EPOLLOUT、EPOLLET）
@@ -66,8 +186,31 @@ private:
     std::unique_ptr<ThreadsPool> m_threadsPool;
     
     std::unique_ptr<Epoller> m_epoller;
+    std::unique_ptr<Watchdog> m_watchdog;
+    std::unique_ptr<IpLimiter> m_ipLimiter;
+    /* 工作线程交回连接的完成队列：epoll_ctl、定时器和 m_users 只在反应堆中修改 */
+    std::unique_ptr<CompletionQueue> m_completions;
+    std::unique_ptr<Upgrader> m_upgrader;
+
+    /* 不停机升级：新进程就绪后旧进程停止 accept，排空连接后退出 */
+    bool m_draining;
+    uint64_t m_drainDeadlineUs;
+    int m_upgradeDrain;         // 排空的最长时间（毫秒），超时后直接退出
+    int m_upgradeIdleClose;     // 排空期间空闲超过该时长（毫秒）的长连接直接关闭
     std::unordered_map<int, HttpConn> m_users;      // 客户端连接映射表（fd -> HttpConn 对象）
 
+    /* 异步数据库连接的监听表（fd -> 挂起的协程） */
+    struct DbWatch
+    {
+        std::coroutine_handle<> handle;
+        uint32_t* revents;
+        bool added;             // 是否已经加入 epoll
+        uint64_t deadlineUs;    // 等待的截止时间，0 为不超时
+    };
+    bool m_asyncDb;
+    std::mutex m_dbWatchMtx;
+    std::unordered_map<int, DbWatch> m_dbWatches;
+
 };
 
 #endif
\ No newline at end of file
@@ -67,10 +67,10 @@ void MinHeapTimer::tick()
             break;
         }
 
-        // 执行回调
-        top.cb();
+        // 先出堆再执行回调，回调中可以为同一 id 重新添加定时器
         heap.pop();
         nodes.erase(top.id);
+        top.cb();
     }
 
 }
@@ -0,0 +1,147 @@
+#ifndef COTASK_H
+#define COTASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <iostream>
+
+/**
+ *  基于 C++20 协程的最小任务类型
+ *  Task<T>   : 惰性启动，被 co_await 时才开始执行，结束后恢复等待者（对称转移）
+ *  Detached  : 立即启动，执行完自动销毁，用作顶层入口（由线程池/反应堆驱动）
+ */
+
+template<typename T>
+class Task;
+
+namespace detail
+{
+
+struct PromiseBase
+{
+    std::coroutine_handle<> m_continuation;     // 等待本任务结束的协程
+    std::exception_ptr m_exception;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            std::coroutine_handle<> cont = h.promise().m_continuation;
+            return cont ? cont : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { m_exception = std::current_exception(); }
+};
+
+} // namespace detail
+
+
+template<typename T>
+class Task
+{
+public:
+    struct promise_type : detail::PromiseBase
+    {
+        std::optional<T> m_value;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_value(T value) { m_value = std::move(value); }
+    };
+
+public:
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if(m_handle) m_handle.destroy(); }
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().m_continuation = awaiting;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        if(m_handle.promise().m_exception)
+        {
+            std::rethrow_exception(m_handle.promise().m_exception);
+        }
+        return std::move(*m_handle.promise().m_value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : m_handle(h) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+
+template<>
+class Task<void>
+{
+public:
+    struct promise_type : detail::PromiseBase
+    {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        void return_void() {}
+    };
+
+public:
+    Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() { if(m_handle) m_handle.destroy(); }
+
+    bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().m_continuation = awaiting;
+        return m_handle;
+    }
+
+    void await_resume()
+    {
+        if(m_handle.promise().m_exception)
+        {
+            std::rethrow_exception(m_handle.promise().m_exception);
+        }
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : m_handle(h) {}
+
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+
+struct Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept
+        {
+#ifdef DEBUG
+            std::cerr << "Detached coroutine threw an exception" << std::endl;
+#endif
+        }
+    };
+};
+
+#endif
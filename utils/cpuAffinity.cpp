@@ -0,0 +1,257 @@
+#include "cpuAffinity.h"
+
+#include <sched.h>
+#include <dirent.h>
+#include <sys/socket.h>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include "../log/log.h"
+
+thread_local int CpuAffinity::t_node = -1;
+thread_local int CpuAffinity::t_slot = -1;
+
+CpuAffinity* CpuAffinity::getInstance()
+{
+    static CpuAffinity affinity;
+    return &affinity;
+}
+
+CpuAffinity::CpuAffinity()
+:m_enable(false), m_incomingCpu(true), m_nodeNum(1)
+{
+    if(!loadConfigFile())
+    {
+#ifdef DEBUG
+        std::cout << "CpuAffinity use default configuration..." << std::endl;
+#endif
+    }
+
+    loadTopology();
+
+    // 去掉进程不允许使用的 CPU（容器、taskset 限制）
+    CPU_ZERO(&m_processCpus);
+    if(sched_getaffinity(0, sizeof(m_processCpus), &m_processCpus) == 0)
+    {
+        for(std::vector<int>& cpus : m_cpus)
+        {
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&](int cpu){
+                return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &m_processCpus);
+            }), cpus.end());
+        }
+    }
+    m_workerLoad.assign(m_cpus[WORKER].size(), 0);
+}
+
+bool CpuAffinity::loadConfigFile()
+{
+    m_configPath = getConfigPath() + "affinity.conf";
+#ifdef DEBUG
+    std::cout << "[configParh:] " << m_configPath << std::endl;
+#endif
+    std::ifstream ifs(m_configPath);
+
+    if(ifs.is_open())
+    {
+        string line;
+        size_t idx;
+        string key;
+        string value;
+
+        while(std::getline(ifs, line))
+        {
+            idx = line.find('=');
+            if(idx == string::npos || line[0] == '#')
+            {
+                continue;
+            }
+
+            key = line.substr(0, idx);
+            value = line.substr(idx + 1);
+
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+            if(key == "enable")
+            {
+                m_enable = std::stoi(value) != 0;
+            }
+            else if(key == "reactorcpus")
+            {
+                m_cpus[REACTOR] = parseCpuList(value);
+            }
+            else if(key == "workercpus")
+            {
+                m_cpus[WORKER] = parseCpuList(value);
+            }
+            else if(key == "dbcpus")
+            {
+                m_cpus[DB] = parseCpuList(value);
+            }
+            else if(key == "incomingcpu")
+            {
+                m_incomingCpu = std::stoi(value) != 0;
+            }
+        }
+
+        ifs.close();
+        return true;
+    }
+
+    return false;
+}
+
+void CpuAffinity::loadTopology()
+{
+    // 没有 NUMA 信息（未开启 NUMA 的内核）时所有 CPU 都在节点 0
+    DIR* dir = opendir("/sys/devices/system/node");
+    if(dir == nullptr)
+    {
+        return;
+    }
+
+    struct dirent* entry;
+    while((entry = readdir(dir)) != nullptr)
+    {
+        int node;
+        if(sscanf(entry->d_name, "node%d", &node) != 1)
+        {
+            continue;
+        }
+
+        std::ifstream ifs(string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+        string list;
+        std::getline(ifs, list);
+        for(int cpu : parseCpuList(list))
+        {
+            if(cpu >= static_cast<int>(m_cpuNode.size()))
+            {
+                m_cpuNode.resize(cpu + 1, 0);
+            }
+            m_cpuNode[cpu] = node;
+        }
+        m_nodeNum = std::max(m_nodeNum, node + 1);
+    }
+    closedir(dir);
+}
+
+std::vector<int> CpuAffinity::parseCpuList(const string& list)
+{
+    // 与 /sys 和 taskset -c 相同的格式："0-3,8,10-11"
+    std::vector<int> cpus;
+    size_t start = 0;
+    while(start < list.size())
+    {
+        size_t end = list.find(',', start);
+        if(end == string::npos) end = list.size();
+
+        string item = list.substr(start, end - start);
+        int lo, hi;
+        int n = sscanf(item.c_str(), "%d-%d", &lo, &hi);
+        if(n == 1)
+        {
+            hi = lo;
+        }
+        if(n >= 1 && lo >= 0 && hi >= lo)
+        {
+            for(int cpu = lo; cpu <= hi; ++cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        start = end + 1;
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+int CpuAffinity::nodeOf(int cpu) const
+{
+    if(cpu < 0 || cpu >= static_cast<int>(m_cpuNode.size()))
+    {
+        return 0;
+    }
+    return m_cpuNode[cpu];
+}
+
+bool CpuAffinity::setAffinity(const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int cpu : cpus)
+    {
+        CPU_SET(cpu, &set);
+    }
+
+    int ret = sched_setaffinity(0, sizeof(set), &set);
+    if(ret != 0)
+    {
+        LOG_WARN("affinity: bind thread to %zu cpus failed: %s", cpus.size(), strerror(errno));
+    }
+    return ret == 0;
+}
+
+int CpuAffinity::pin(ROLE role)
+{
+    const std::vector<int>& cpus = m_cpus[role];
+    if(!m_enable || cpus.empty())
+    {
+        return -1;
+    }
+
+    if(role == WORKER)
+    {
+        int cpu;
+        {
+            std::lock_guard<std::mutex> locker(m_mtx);
+            t_slot = static_cast<int>(std::min_element(m_workerLoad.begin(), m_workerLoad.end()) - m_workerLoad.begin());
+            ++m_workerLoad[t_slot];
+            cpu = cpus[t_slot];
+        }
+        t_node = setAffinity({ cpu }) ? nodeOf(cpu) : -1;
+        return t_node;
+    }
+
+    // 集合内的 CPU 都在同一节点时才视为绑定到该节点
+    int node = nodeOf(cpus.front());
+    for(int cpu : cpus)
+    {
+        if(nodeOf(cpu) != node)
+        {
+            node = -1;
+            break;
+        }
+    }
+    t_node = setAffinity(cpus) ? node : -1;
+    return t_node;
+}
+
+void CpuAffinity::unpin()
+{
+    if(t_slot < 0)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> locker(m_mtx);
+    --m_workerLoad[t_slot];
+    t_slot = -1;
+}
+
+int CpuAffinity::incomingNode(int fd) const
+{
+    if(!m_enable || !m_incomingCpu)
+    {
+        return -1;
+    }
+
+    int cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if(getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0 || cpu < 0)
+    {
+        return -1;
+    }
+    return nodeOf(cpu);
+}
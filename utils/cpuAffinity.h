@@ -0,0 +1,82 @@
+#ifndef CPUAFFINITY_H
+#define CPUAFFINITY_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <algorithm>
+#include <sched.h>
+
+#include "pathInfo.h"
+
+using std::string;
+
+/**
+ *  CPU 绑定与 NUMA 节点感知
+ *  - 反应堆、工作线程、数据库线程各自绑定到配置的 CPU 集合（空表示不绑定，沿用进程的 CPU 集合）
+ *  - 工作线程各占一个 CPU，新线程取当前线程数最少的 CPU，因此扩缩容后仍均匀分布
+ *  - 连接的所属节点取 SO_INCOMING_CPU（处理该连接收包软中断的 CPU）所在节点，
+ *    线程池优先让同节点的工作线程处理它的任务，缓冲区在工作线程上重新分配（首次写入落在本节点）
+ *  - 节点拓扑读 /sys/devices/system/node，不依赖 libnuma
+ */
+class CpuAffinity
+{
+public:
+    enum ROLE
+    {
+        REACTOR = 0,
+        WORKER,
+        DB,
+        ROLE_NUM,
+    };
+
+public:
+    static CpuAffinity* getInstance();
+
+    CpuAffinity(const CpuAffinity&) = delete;
+    CpuAffinity& operator=(const CpuAffinity&) = delete;
+
+    bool enabled() const { return m_enable; }
+    /* 线程池按节点分队列的数量，未启用为 1 */
+    int nodeCount() const { return m_enable ? m_nodeNum : 1; }
+
+    /* 把当前线程绑定到该角色的 CPU，返回所在节点（集合跨节点或未绑定为 -1） */
+    int pin(ROLE role);
+    /* 工作线程退出时归还占用的 CPU */
+    void unpin();
+
+    /* 当前线程绑定的节点，未绑定为 -1 */
+    static int currentNode() { return t_node; }
+    /* 连接收包 CPU 所在的节点，未启用或无法获取为 -1 */
+    int incomingNode(int fd) const;
+    /* 进程启动时的 CPU 集合，热升级的新进程从这里开始，而不是继承反应堆的绑定 */
+    const cpu_set_t& processCpus() const { return m_processCpus; }
+
+private:
+    CpuAffinity();
+    bool loadConfigFile();
+    void loadTopology();
+
+    static std::vector<int> parseCpuList(const string& list);
+    int nodeOf(int cpu) const;
+    bool setAffinity(const std::vector<int>& cpus);
+
+private:
+    bool m_enable;
+    bool m_incomingCpu;                     // 是否按 SO_INCOMING_CPU 确定连接所属节点
+    string m_configPath;
+
+    std::vector<int> m_cpus[ROLE_NUM];
+    std::vector<int> m_cpuNode;             // 下标为 CPU 编号
+    cpu_set_t m_processCpus;
+    int m_nodeNum;
+
+    std::mutex m_mtx;
+    std::vector<int> m_workerLoad;          // 与 m_cpus[WORKER] 对应，每个 CPU 上的工作线程数
+
+    static thread_local int t_node;
+    static thread_local int t_slot;         // 工作线程占用的 m_workerLoad 下标
+};
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+/* SHA-256 摘要，用于口令的加盐哈希 */
+class Sha256
+{
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Sha256();
+
+    void update(const void* data, size_t len);
+    void final(uint8_t digest[DIGEST_SIZE]);
+
+    // 一次性计算，返回 32 字节的二进制摘要
+    static std::string hash(const std::string& data);
+
+private:
+    void transform(const uint8_t block[64]);
+
+private:
+    uint32_t m_state[8];
+    uint64_t m_bitLen;
+    uint8_t m_block[64];
+    size_t m_blockLen;
+};
+
+#endif